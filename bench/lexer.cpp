@@ -0,0 +1,146 @@
+// compares the throughput of the sscanf based number/identifier scanning the
+// tokenizer used to do against lexnumber/lexidentifier.
+//
+// usage: lexer_bench [file.lp]
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <strings.h>
+
+#include "lexer.hpp"
+#include "mappedfile.hpp"
+
+struct LexResult {
+   size_t nnumbers = 0;
+   size_t nidentifiers = 0;
+   size_t nsymbols = 0;
+   double checksum = 0.0;
+};
+
+// line by line copy and sscanf, as the fgets based tokenizer did
+LexResult lexsscanf(const char* begin, const char* end) {
+   LexResult result;
+   std::string line;
+   std::string name;
+   while (begin < end) {
+      const char* lineend = (const char*)memchr(begin, '\n', end - begin);
+      if (lineend == nullptr) {
+         lineend = end;
+      }
+      line.assign(begin, lineend);
+      begin = lineend + 1;
+      name.resize(line.size() + 1);
+
+      const char* pos = line.c_str();
+      while (*pos != '\0' && *pos != '\\') {
+         if (strchr(" \t\r", *pos) != nullptr) {
+            pos++;
+            continue;
+         }
+         if (strchr("[]<>=:+^/*-", *pos) != nullptr) {
+            result.nsymbols++;
+            pos++;
+            continue;
+         }
+
+         double constant;
+         int ncharconsumed;
+         if (sscanf(pos, "%lf%n", &constant, &ncharconsumed) == 1) {
+            result.nnumbers++;
+            result.checksum += constant;
+            pos += ncharconsumed;
+            continue;
+         }
+         if (sscanf(pos, "%[^][\t\n\r\\:+<>^= /-]%n", &name[0], &ncharconsumed) == 1) {
+            result.nidentifiers++;
+            pos += ncharconsumed;
+            continue;
+         }
+         break;
+      }
+   }
+   return result;
+}
+
+LexResult lexfast(const char* pos, const char* end) {
+   LexResult result;
+   while (pos < end) {
+      switch (*pos) {
+         case '\\': {
+            const char* lineend = (const char*)memchr(pos, '\n', end - pos);
+            pos = lineend == nullptr ? end : lineend;
+            continue;
+         }
+         case ' ': case '\t': case '\r': case '\n':
+            pos++;
+            continue;
+         case '[': case ']': case '<': case '>': case '=': case ':':
+         case '+': case '^': case '/': case '*': case '-':
+            result.nsymbols++;
+            pos++;
+            continue;
+      }
+
+      double constant;
+      const char* next = lexnumber(pos, end, constant);
+      if (next != pos) {
+         result.nnumbers++;
+         result.checksum += constant;
+         pos = next;
+         continue;
+      }
+      next = lexidentifier(pos, end);
+      if (next == pos) {
+         break;
+      }
+      // sscanf reads inf as a number, the reader maps the keyword later on
+      if ((next - pos == 3 && strncasecmp(pos, "inf", 3) == 0) || (next - pos == 8 && strncasecmp(pos, "infinity", 8) == 0)) {
+         result.nnumbers++;
+         result.checksum += HUGE_VAL;
+      } else {
+         result.nidentifiers++;
+      }
+      pos = next;
+   }
+   return result;
+}
+
+template <typename F>
+double measure(F lex, const MappedFile& file, LexResult& result) {
+   typedef std::chrono::steady_clock clock;
+   unsigned int reps = 0;
+   clock::time_point start = clock::now();
+   double elapsed;
+   do {
+      result = lex(file.begin(), file.end());
+      reps++;
+      elapsed = std::chrono::duration<double>(clock::now() - start).count();
+   } while (elapsed < 1.0);
+   return file.length() * (double)reps / elapsed / 1e6;
+}
+
+int main(int argc, char** argv) {
+   std::string filename = argc > 1 ? argv[1] : PROJECT_DIR "/check/qap10.lp";
+   MappedFile file(filename);
+
+   LexResult reference;
+   LexResult result;
+   double mbsscanf = measure(lexsscanf, file, reference);
+   double mbfast = measure(lexfast, file, result);
+
+   bool identical = reference.nnumbers == result.nnumbers
+      && reference.nidentifiers == result.nidentifiers
+      && reference.nsymbols == result.nsymbols
+      && reference.checksum == result.checksum;
+
+   printf("file        %s (%zu bytes)\n", filename.c_str(), file.length());
+   printf("tokens      %zu numbers, %zu identifiers, %zu symbols\n", result.nnumbers, result.nidentifiers, result.nsymbols);
+   printf("sscanf      %8.1f MB/s\n", mbsscanf);
+   printf("lexer       %8.1f MB/s\n", mbfast);
+   printf("speedup     %8.2fx\n", mbfast / mbsscanf);
+   printf("identical   %s\n", identical ? "yes" : "NO");
+   return identical ? 0 : 1;
+}
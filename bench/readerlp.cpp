@@ -0,0 +1,424 @@
+// reads and writes synthetic LP/QP files of a given size and shape, and
+// reports throughput, peak memory and allocations as one JSON object per run.
+// the files only depend on the options, so results can be tracked over time.
+//
+// usage: readerlp_bench [--rows=N] [--cols=N] [--density=D] [--quadratic=Q]
+//                       [--namelength=L] [--linelength=W] [--reps=R]
+//                       [--threads=T] [--arena=B] [--seed=S] [--file=name.lp] [--keep]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <random>
+#include <string>
+
+#include <sys/resource.h>
+
+#include "compactmodel.hpp"
+#include "reader.hpp"
+#include "writer.hpp"
+
+// every allocation of the process is counted, including those of the library
+static std::atomic<uint64_t> nallocations(0);
+
+void* operator new(size_t size) {
+   nallocations++;
+   void* p = malloc(size > 0 ? size : 1);
+   if (p == nullptr) {
+      throw std::bad_alloc();
+   }
+   return p;
+}
+
+void* operator new[](size_t size) {
+   return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+   free(p);
+}
+
+void operator delete[](void* p) noexcept {
+   free(p);
+}
+
+struct BenchOptions {
+   uint64_t rows = 100000;
+   uint64_t cols = 100000;
+   double density = 1e-4;        // share of the columns in each row
+   double quadratic = 0.0;       // share of the rows with a quadratic part
+   unsigned int namelength = 8;  // variables and rows are named like x0000042
+   unsigned int linelength = 0;  // rows are wrapped after this many characters, 0 for never
+   unsigned int reps = 3;
+   unsigned int threads = 1;
+   uint64_t arena = 0;           // block size of the arena to read into, 0 to read a Model
+   uint64_t seed = 1;
+   std::string file = "readerlp_bench.lp";
+   bool keep = false;
+};
+
+bool parseoption(const char* arg, const char* name, std::string& value) {
+   size_t length = strlen(name);
+   if (strncmp(arg, name, length) != 0 || arg[length] != '=') {
+      return false;
+   }
+   value = arg + length + 1;
+   return true;
+}
+
+bool parseoptions(int argc, char** argv, BenchOptions& options) {
+   for (int i=1; i<argc; i++) {
+      std::string value;
+      if (parseoption(argv[i], "--rows", value)) {
+         options.rows = strtoull(value.c_str(), nullptr, 10);
+      } else if (parseoption(argv[i], "--cols", value)) {
+         options.cols = strtoull(value.c_str(), nullptr, 10);
+      } else if (parseoption(argv[i], "--density", value)) {
+         options.density = strtod(value.c_str(), nullptr);
+      } else if (parseoption(argv[i], "--quadratic", value)) {
+         options.quadratic = strtod(value.c_str(), nullptr);
+      } else if (parseoption(argv[i], "--namelength", value)) {
+         options.namelength = (unsigned int)strtoul(value.c_str(), nullptr, 10);
+      } else if (parseoption(argv[i], "--linelength", value)) {
+         options.linelength = (unsigned int)strtoul(value.c_str(), nullptr, 10);
+      } else if (parseoption(argv[i], "--reps", value)) {
+         options.reps = std::max(1u, (unsigned int)strtoul(value.c_str(), nullptr, 10));
+      } else if (parseoption(argv[i], "--threads", value)) {
+         options.threads = (unsigned int)strtoul(value.c_str(), nullptr, 10);
+      } else if (parseoption(argv[i], "--arena", value)) {
+         options.arena = strtoull(value.c_str(), nullptr, 10);
+      } else if (parseoption(argv[i], "--seed", value)) {
+         options.seed = strtoull(value.c_str(), nullptr, 10);
+      } else if (parseoption(argv[i], "--file", value)) {
+         options.file = value;
+      } else if (strcmp(argv[i], "--keep") == 0) {
+         options.keep = true;
+      } else {
+         fprintf(stderr, "unknown option %s\n", argv[i]);
+         return false;
+      }
+   }
+   return options.rows > 0 && options.cols > 0;
+}
+
+// writes the file piece by piece, so that its size is not limited by memory.
+// only the raw output of the generator is used, which unlike the standard
+// distributions is the same on every platform.
+class Generator {
+private:
+   const BenchOptions& options;
+   std::mt19937_64 rng;
+   FILE* file;
+   std::string buffer;
+   size_t linestart = 0;
+
+   uint64_t random(uint64_t n) { return rng() % n; }
+   bool chance(double p) { return (double)(rng() >> 11) * (1.0 / 9007199254740992.0) < p; }
+
+   void name(char prefix, uint64_t index) {
+      char number[32];
+      int width = options.namelength > 1 ? (int)options.namelength - 1 : 1;
+      snprintf(number, sizeof(number), "%0*llu", width, (unsigned long long)index);
+      buffer += prefix;
+      buffer += number;
+   }
+
+   void coefficient(bool first) {
+      char number[32];
+      uint64_t value = 1 + random(999999);
+      bool negative = chance(0.3);
+      snprintf(number, sizeof(number), "%s%llu.%03llu ", negative ? "- " : first ? "" : "+ ", (unsigned long long)(value / 1000), (unsigned long long)(value % 1000));
+      buffer += number;
+   }
+
+   // starts a new line within a row once the current one is long enough
+   void wrap() {
+      if (options.linelength > 0 && buffer.size() - linestart >= options.linelength) {
+         buffer += "\n ";
+         linestart = buffer.size() - 1;
+      }
+   }
+
+   void endline() {
+      buffer += '\n';
+      linestart = buffer.size();
+      if (buffer.size() >= (1 << 20)) {
+         flush();
+      }
+   }
+
+   void flush() {
+      if (fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size()) {
+         fprintf(stderr, "cannot write %s\n", options.file.c_str());
+         exit(1);
+      }
+      linestart -= std::min(linestart, buffer.size());
+      buffer.clear();
+   }
+
+   uint64_t expression(uint64_t length, uint64_t nquad);
+
+public:
+   uint64_t nonzeros = 0;
+
+   Generator(const BenchOptions& options) : options(options), rng(options.seed), file(fopen(options.file.c_str(), "w")) {
+      if (file == nullptr) {
+         fprintf(stderr, "cannot open %s\n", options.file.c_str());
+         exit(1);
+      }
+   }
+
+   ~Generator() {
+      fclose(file);
+   }
+
+   void generate();
+};
+
+uint64_t Generator::expression(uint64_t length, uint64_t nquad) {
+   for (uint64_t k=0; k<length; k++) {
+      coefficient(k == 0);
+      name('x', random(options.cols));
+      buffer += ' ';
+      wrap();
+   }
+   if (nquad > 0) {
+      buffer += "+ [ ";
+      for (uint64_t k=0; k<nquad; k++) {
+         coefficient(k == 0);
+         uint64_t var1 = random(options.cols);
+         uint64_t var2 = random(options.cols);
+         name('x', var1);
+         if (var1 == var2) {
+            buffer += "^2 ";
+         } else {
+            buffer += " * ";
+            name('x', var2);
+            buffer += ' ';
+         }
+         wrap();
+      }
+      buffer += "]/2 ";
+   }
+   return length + nquad;
+}
+
+void Generator::generate() {
+   uint64_t rowlength = std::max((uint64_t)1, (uint64_t)(options.density * options.cols + 0.5));
+
+   buffer += "\\ synthetic instance of readerlp_bench\nminimize\n obj: ";
+   expression(rowlength, options.quadratic > 0.0 ? rowlength : 0);
+   endline();
+
+   buffer += "subject to\n";
+   for (uint64_t i=0; i<options.rows; i++) {
+      buffer += ' ';
+      name('c', i);
+      buffer += ": ";
+      // lengths vary around the mean, some rows are much longer
+      uint64_t length = 1 + random(2 * rowlength);
+      if (random(100) == 0) {
+         length *= 10;
+      }
+      uint64_t nquad = chance(options.quadratic) ? 1 + random(rowlength) : 0;
+      nonzeros += expression(length, nquad);
+      uint64_t sense = random(3);
+      buffer += sense == 0 ? "<= " : sense == 1 ? ">= " : "= ";
+      buffer += std::to_string(random(1000));
+      endline();
+   }
+
+   // every column gets a bound, so that all of them exist
+   buffer += "bounds\n";
+   for (uint64_t j=0; j<options.cols; j++) {
+      buffer += ' ';
+      switch (j % 4) {
+         case 0:
+            buffer += "0 <= ";
+            name('x', j);
+            buffer += " <= " + std::to_string(1 + random(100));
+            break;
+         case 1:
+            name('x', j);
+            buffer += " >= -" + std::to_string(random(100));
+            break;
+         case 2:
+            name('x', j);
+            buffer += " free";
+            break;
+         default:
+            name('x', j);
+            buffer += " <= " + std::to_string(random(100));
+      }
+      endline();
+   }
+
+   buffer += "generals\n";
+   for (uint64_t j=0; j<options.cols; j+=10) {
+      buffer += ' ';
+      name('x', j);
+      endline();
+   }
+   buffer += "end\n";
+   flush();
+}
+
+long filesize(const std::string& filename) {
+   FILE* file = fopen(filename.c_str(), "rb");
+   if (file == nullptr) {
+      return -1;
+   }
+   fseek(file, 0, SEEK_END);
+   long size = ftell(file);
+   fclose(file);
+   return size;
+}
+
+// the peak resident set size is reset where the system allows it, otherwise
+// it is the peak of the whole run so far
+void resetpeakrss() {
+#ifdef __linux__
+   FILE* file = fopen("/proc/self/clear_refs", "w");
+   if (file != nullptr) {
+      fputs("5", file);
+      fclose(file);
+   }
+#endif
+}
+
+// in kilobytes
+long peakrss() {
+#ifdef __linux__
+   FILE* file = fopen("/proc/self/status", "r");
+   if (file != nullptr) {
+      char line[256];
+      long value = -1;
+      while (fgets(line, sizeof(line), file) != nullptr) {
+         if (strncmp(line, "VmHWM:", 6) == 0) {
+            value = strtol(line + 6, nullptr, 10);
+            break;
+         }
+      }
+      fclose(file);
+      if (value >= 0) {
+         return value;
+      }
+   }
+#endif
+   struct rusage usage;
+   getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+   return usage.ru_maxrss / 1024;
+#else
+   return usage.ru_maxrss;
+#endif
+}
+
+struct Measurement {
+   double seconds = 1e100;   // fastest of the repetitions
+   long peakrss = 0;
+   uint64_t allocations = 0; // of one repetition
+};
+
+// setup runs before each repetition and is not measured
+template <typename S, typename F>
+Measurement measure(unsigned int reps, S setup, F run) {
+   typedef std::chrono::steady_clock clock;
+   Measurement result;
+   resetpeakrss();
+   for (unsigned int r=0; r<reps; r++) {
+      setup();
+      uint64_t allocations = nallocations;
+      clock::time_point start = clock::now();
+      run();
+      result.seconds = std::min(result.seconds, std::chrono::duration<double>(clock::now() - start).count());
+      result.allocations = nallocations - allocations;
+   }
+   result.peakrss = peakrss();
+   return result;
+}
+
+template <typename F>
+Measurement measure(unsigned int reps, F run) {
+   return measure(reps, []() {}, run);
+}
+
+int main(int argc, char** argv) {
+   BenchOptions options;
+   if (!parseoptions(argc, argv, options)) {
+      fprintf(stderr, "usage: %s [--rows=N] [--cols=N] [--density=D] [--quadratic=Q] [--namelength=L] [--linelength=W] [--reps=R] [--threads=T] [--arena=B] [--seed=S] [--file=name.lp] [--keep]\n", argv[0]);
+      return 2;
+   }
+
+   uint64_t nonzeros;
+   {
+      Generator generator(options);
+      generator.generate();
+      nonzeros = generator.nonzeros;
+   }
+   long bytes = filesize(options.file);
+
+   ReaderOptions readeroptions;
+   readeroptions.nthreads = options.threads;
+   if (options.arena > 0) {
+      readeroptions.arenablocksize = (size_t)options.arena;
+   }
+   Model model;
+   ArenaModel arenamodel;
+   auto readmodel = [&]() {
+      if (options.arena > 0) {
+         arenamodel = readarenainstance(options.file, readeroptions);
+      } else {
+         model = readinstance(options.file, readeroptions);
+      }
+   };
+   auto freemodel = [&]() {
+      model = Model();
+      arenamodel = ArenaModel();
+   };
+   Measurement read = measure(options.reps, freemodel, readmodel);
+
+   // freeing the model read before each repetition
+   Measurement release = measure(options.reps, readmodel, freemodel);
+   readmodel();
+   bool valid = options.arena > 0
+      ? arenamodel.variables.size() == options.cols && arenamodel.constraints.size() == options.rows
+      : model.variables.size() == options.cols && model.constraints.size() == options.rows;
+   if (options.arena > 0) {
+      freemodel();
+      model = readinstance(options.file, readeroptions);
+   }
+
+   std::string writefile = options.file + ".out";
+   WriterOptions writeroptions;
+   writeroptions.nthreads = options.threads;
+   Measurement write = measure(options.reps, [&]() {
+      writeinstance(writefile, model, writeroptions);
+   });
+   long writebytes = filesize(writefile);
+
+   CompactModel written = readcompactinstance(writefile);
+   valid = valid && written.ncols() == options.cols && written.nrows() == options.rows;
+
+   if (!options.keep) {
+      remove(options.file.c_str());
+      remove(writefile.c_str());
+   }
+
+   printf("{\"benchmark\":\"readerlp\",\"rows\":%llu,\"cols\":%llu,\"density\":%g,\"quadratic\":%g,"
+      "\"namelength\":%u,\"linelength\":%u,\"threads\":%u,\"arena\":%llu,\"seed\":%llu,\"bytes\":%ld,\"nonzeros\":%llu,"
+      "\"read_seconds\":%.6f,\"read_mb_per_s\":%.2f,\"read_peak_rss_kb\":%ld,\"read_allocations_per_nonzero\":%.4f,\"free_seconds\":%.6f,"
+      "\"write_bytes\":%ld,\"write_seconds\":%.6f,\"write_mb_per_s\":%.2f,\"write_peak_rss_kb\":%ld,\"write_allocations_per_nonzero\":%.4f,"
+      "\"valid\":%s}\n",
+      (unsigned long long)options.rows, (unsigned long long)options.cols, options.density, options.quadratic,
+      options.namelength, options.linelength, options.threads, (unsigned long long)options.arena, (unsigned long long)options.seed, bytes, (unsigned long long)nonzeros,
+      read.seconds, bytes / read.seconds / 1e6, read.peakrss, (double)read.allocations / nonzeros, release.seconds,
+      writebytes, write.seconds, writebytes / write.seconds / 1e6, write.peakrss, (double)write.allocations / nonzeros,
+      valid ? "true" : "false");
+   return valid ? 0 : 1;
+}
@@ -3,8 +3,32 @@
 #define CATCH_CONFIG_MAIN 
 #include "../external/catch/catch.hpp"
 
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <thread>
+
+#ifndef _WIN32
+#include <dirent.h>
+#endif
+
+#include "arena.hpp"
+#include "arenamodel.hpp"
+#include "builder.hpp"
+#include "cache.hpp"
 #include "config.hpp"
+#include "lexer.hpp"
+#include "numberformat.hpp"
+#include "symboltable.hpp"
 #include "reader.hpp"
+#include "snapshot.hpp"
+#include "streaminput.hpp"
 #include "writer.hpp"
 
 void test_filecontentgarbage() {
@@ -28,6 +52,1336 @@ void test_writer() {
    REQUIRE(m1.constraints.size() == m2.constraints.size());
 }
 
+void test_longline() {
+   // a single row well beyond LP_MAX_LINE_LENGTH without trailing newline
+   FILE* file = fopen("longline.lp", "w");
+   fprintf(file, "min\n obj: x1\nst\n c1:");
+   for (unsigned int i=1; i<=500; i++) {
+      fprintf(file, " + %u x%u", i, i);
+   }
+   fprintf(file, " <= 10\nend");
+   fclose(file);
+
+   Model m = readinstance("longline.lp");
+   REQUIRE(m.variables.size() == 500);
+   REQUIRE(m.constraints.size() == 1);
+   REQUIRE(m.constraints[0]->expr->linterms.size() == 500);
+   REQUIRE(m.constraints[0]->upperbound == 10.0);
+}
+
+void writestring(std::string filename, std::string content) {
+   FILE* file = fopen(filename.c_str(), "w");
+   fputs(content.c_str(), file);
+   fclose(file);
+}
+
+std::string readfile(std::string filename) {
+   FILE* file = fopen(filename.c_str(), "rb");
+   std::string content;
+   char buffer[1 << 16];
+   size_t n;
+   while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+      content.append(buffer, n);
+   }
+   fclose(file);
+   return content;
+}
+
+Model readstring(std::string filename, std::string content) {
+   writestring(filename, content);
+   return readinstance(filename);
+}
+
+void test_streaming() {
+   Model m = readstring("streaming.lp",
+      "max\n obj: 2 x + 3 y\n"
+      "st\n x + y <= 4\n c2: x - y\n >= -1 c3: 2 x +\n z = 3\n"
+      "bounds\n x free\n -1 <= y <= 1\n 2 <= z\n y >= -0.5\n"
+      "general\n z\nend\n");
+   REQUIRE(m.sense == ObjectiveSense::MAX);
+   REQUIRE(m.objective->linterms.size() == 2);
+   REQUIRE(m.constraints.size() == 3);
+   REQUIRE(m.constraints[0]->expr->name == "");
+   REQUIRE(m.constraints[1]->expr->name == "c2");
+   REQUIRE(m.constraints[1]->lowerbound == -1.0);
+   REQUIRE(m.constraints[2]->expr->name == "c3");
+   REQUIRE(m.constraints[2]->lowerbound == 3.0);
+   REQUIRE(m.constraints[2]->upperbound == 3.0);
+   REQUIRE(m.variables.size() == 3);
+   REQUIRE(m.variables[0]->lowerbound == -std::numeric_limits<double>::infinity());
+   REQUIRE(m.variables[1]->lowerbound == -0.5);
+   REQUIRE(m.variables[1]->upperbound == 1.0);
+   REQUIRE(m.variables[2]->lowerbound == 2.0);
+   REQUIRE(m.variables[2]->type == VariableType::GENERAL);
+
+   // sections out of order are taken in the order objective, constraints,
+   // bounds, general, binary, which numbers the variables and makes binary
+   // win over general
+   Model r = readstring("sectionorder.lp",
+      "binary\n w\ngeneral\n w v\nbounds\n u <= 3\n"
+      "st\n c1: v + u + t >= 1\nmin\n obj: t + s\nend\n");
+   const char* names[] = {"t", "s", "v", "u", "w"};
+   REQUIRE(r.variables.size() == 5);
+   for (int i=0; i<5; i++) {
+      REQUIRE(r.variables[i]->name == names[i]);
+   }
+   REQUIRE(r.variables[2]->type == VariableType::GENERAL);
+   REQUIRE(r.variables[3]->upperbound == 3.0);
+   REQUIRE(r.variables[4]->type == VariableType::BINARY);
+   REQUIRE(r.constraints.size() == 1);
+   REQUIRE(r.objective->linterms.size() == 2);
+}
+
+TEST_CASE( "streaming", "" ) {
+   test_streaming();
+}
+
+void test_symboltable() {
+   SymbolTable table;
+   bool inserted;
+   for (unsigned int i=0; i<10000; i++) {
+      std::string name = "x" + std::to_string(i);
+      REQUIRE(table.intern(name.c_str(), name.size(), inserted) == i);
+      REQUIRE(inserted);
+   }
+   for (unsigned int i=0; i<10000; i++) {
+      std::string name = "x" + std::to_string(i);
+      REQUIRE(table.intern(name.c_str(), name.size(), inserted) == i);
+      REQUIRE(!inserted);
+      REQUIRE(table.str(i) == name);
+   }
+   // lookups work on names that are not null-terminated
+   REQUIRE(table.find("x12345", 3) == 12);
+   REQUIRE(table.find("y1", 2) == SymbolTable::NONE);
+   REQUIRE(table.size() == 10000);
+}
+
+TEST_CASE( "symboltable", "" ) {
+   test_symboltable();
+}
+
+void test_compactmodel() {
+   writestring("compact.lp",
+      "min\n obj: x + [ 2 x ^ 2 ] / 2\n"
+      "st\n c1: x + 2 y <= 4\n c2: 3 z - y >= 1\n x + [ y * z ] / 2 = 2\n"
+      "bounds\n y <= 5\n"
+      "binary\n z\nend\n");
+   CompactModel m = readcompactinstance("compact.lp");
+   REQUIRE(m.ncols() == 3);
+   REQUIRE(m.colname(0) == "x");
+   REQUIRE(m.colname(2) == "z");
+   REQUIRE(m.colupper[1] == 5.0);
+   REQUIRE(m.coltype[2] == VariableType::BINARY);
+   REQUIRE(m.objname == "obj");
+   REQUIRE(m.objindex == std::vector<uint32_t>({0}));
+   REQUIRE(m.objoffset == 0.0);
+   REQUIRE(m.objhessian.ncols() == 3);
+   REQUIRE(m.objhessian.nnz() == 1);
+
+   REQUIRE(m.nrows() == 3);
+   REQUIRE(m.rowname(0) == "c1");
+   REQUIRE(m.rowname(2) == "");
+   REQUIRE(m.rowstart == std::vector<size_t>({0, 2, 4, 5}));
+   REQUIRE(m.colindex == std::vector<uint32_t>({0, 1, 2, 1, 0}));
+   REQUIRE(m.value == std::vector<double>({1.0, 2.0, 3.0, -1.0, 1.0}));
+   REQUIRE(m.rowupper[0] == 4.0);
+   REQUIRE(m.rowlower[1] == 1.0);
+   REQUIRE(m.rowlower[2] == 2.0);
+   REQUIRE(m.quadrows == std::vector<uint32_t>({2}));
+   REQUIRE(m.rowhessians[0].start == std::vector<size_t>({0, 0, 1}));
+   REQUIRE(m.rowhessians[0].index == std::vector<uint32_t>({2}));
+   REQUIRE(m.rowhessians[0].value == std::vector<double>({0.5}));
+
+   // the Model view carries the same content
+   Model model = createmodel(m);
+   REQUIRE(model.variables.size() == 3);
+   REQUIRE(model.constraints[1]->expr->linterms[1]->var == model.variables[1]);
+   REQUIRE(model.constraints[2]->expr->quadterms.size() == 1);
+}
+
+TEST_CASE( "compactmodel", "" ) {
+   test_compactmodel();
+}
+
+void test_columnmatrix() {
+   // large enough to be split over several threads
+   CompactModel m;
+   std::mt19937 rng(7);
+   const uint32_t ncols = 1000;
+   m.collower.assign(ncols, 0.0);
+   for (uint32_t row=0; row<20000; row++) {
+      unsigned int length = rng() % 30;
+      for (unsigned int k=0; k<length; k++) {
+         m.colindex.push_back(rng() % ncols);
+         m.value.push_back(row + k / 100.0);
+      }
+      m.rowlower.push_back(0.0);
+      m.rowstart.push_back(m.value.size());
+   }
+   m.objindex = {3, 5, 3};
+   m.objvalue = {1.0, 2.0, 4.0};
+
+   // straightforward transpose for reference
+   std::vector<std::vector<std::pair<uint32_t, double>>> columns(ncols);
+   for (uint32_t row=0; row<m.nrows(); row++) {
+      for (size_t k=m.rowstart[row]; k<m.rowstart[row+1]; k++) {
+         columns[m.colindex[k]].push_back(std::make_pair(row, m.value[k]));
+      }
+   }
+
+   for (unsigned int nthreads : {1, 3, 8}) {
+      ColumnMatrix a = createcolumnmatrix(m, nthreads);
+      REQUIRE(a.objective.size() == ncols);
+      REQUIRE(a.objective[3] == 5.0);
+      REQUIRE(a.objective[5] == 2.0);
+      REQUIRE(a.colstart.size() == ncols + 1);
+      REQUIRE(a.colstart[ncols] == m.nnz());
+      bool same = true;
+      for (uint32_t col=0; col<ncols; col++) {
+         same = same && a.colstart[col+1] - a.colstart[col] == columns[col].size();
+         for (size_t k=0; same && k<columns[col].size(); k++) {
+            same = a.rowindex[a.colstart[col] + k] == columns[col][k].first
+               && a.value[a.colstart[col] + k] == columns[col][k].second;
+         }
+      }
+      REQUIRE(same);
+   }
+}
+
+TEST_CASE( "columnmatrix", "" ) {
+   test_columnmatrix();
+}
+
+void test_hessian() {
+   writestring("hessian.lp",
+      "min\n obj: [ x * y + 3 y * x + 2 x ^ 2 - z * x + y * z + z ^ 2 + z * x ] / 2\n"
+      "st\n c1: x + y + z + w >= 1\nend\n");
+   CompactModel m = readcompactinstance("hessian.lp");
+   // x_i * x_j is stored once as Q_ij = c/2 in the lower triangle, x_i^2 as Q_ii = c
+   REQUIRE(m.objhessian.ncols() == 4);
+   REQUIRE(m.objhessian.start == std::vector<size_t>({0, 3, 4, 5, 5}));
+   REQUIRE(m.objhessian.index == std::vector<uint32_t>({0, 1, 2, 2, 2}));
+   REQUIRE(m.objhessian.value == std::vector<double>({2.0, 2.0, 0.0, 0.5, 1.0}));
+
+   // larger indices need more radix passes
+   QuadraticPart quad;
+   std::mt19937 rng(3);
+   std::map<std::pair<uint32_t, uint32_t>, double> reference;
+   for (unsigned int k=0; k<50000; k++) {
+      uint32_t i = rng() % 70000;
+      uint32_t j = rng() % 4 == 0 ? i : rng() % 70000;
+      quad.index1.push_back(i);
+      quad.index2.push_back(j);
+      quad.value.push_back(k % 7 + 1.0);
+      reference[std::make_pair(std::min(i, j), std::max(i, j))] += i == j ? k % 7 + 1.0 : (k % 7 + 1.0) / 2;
+   }
+   Hessian h = createhessian(quad, 100000);
+   REQUIRE(h.ncols() == 100000);
+   REQUIRE(h.nnz() == reference.size());
+   auto it = reference.begin();
+   bool same = true;
+   for (uint32_t col=0; col<h.ncols(); col++) {
+      for (size_t k=h.start[col]; k<h.start[col+1]; k++, it++) {
+         same = same && it->first.first == col && it->first.second == h.index[k] && it->second == h.value[k];
+      }
+   }
+   REQUIRE(same);
+}
+
+TEST_CASE( "hessian", "" ) {
+   test_hessian();
+}
+
+void test_snapshot() {
+   std::string filename = std::string(PROJECT_DIR) + "/check/QPLIB_8938.lp";
+   CompactModel m = readcompactinstance(filename);
+   writesnapshot("QPLIB_8938.snapshot", m);
+
+   {
+      Snapshot snapshot("QPLIB_8938.snapshot");
+      REQUIRE(snapshot.ncols() == m.ncols());
+      REQUIRE(snapshot.nrows() == m.nrows());
+      REQUIRE(snapshot.nnz() == m.nnz());
+      REQUIRE(snapshot.collower.copy() == m.collower);
+      REQUIRE(snapshot.colindex.copy() == m.colindex);
+      REQUIRE(snapshot.objhessian.value.copy() == m.objhessian.value);
+   }
+
+   CompactModel r = readsnapshot("QPLIB_8938.snapshot");
+   REQUIRE(r.sense == m.sense);
+   REQUIRE(r.coltype == m.coltype);
+   REQUIRE(r.colnames == m.colnames);
+   REQUIRE(r.colnamestart == m.colnamestart);
+   REQUIRE(r.objname == m.objname);
+   REQUIRE(r.objindex == m.objindex);
+   REQUIRE(r.objvalue == m.objvalue);
+   REQUIRE(r.objhessian.start == m.objhessian.start);
+   REQUIRE(r.objhessian.index == m.objhessian.index);
+   REQUIRE(r.rowlower == m.rowlower);
+   REQUIRE(r.rowupper == m.rowupper);
+   REQUIRE(r.rowstart == m.rowstart);
+   REQUIRE(r.value == m.value);
+   REQUIRE(r.rownames == m.rownames);
+   REQUIRE(r.quadrows == m.quadrows);
+
+   // a Model goes through the compact form unchanged
+   Model model = readinstance(filename);
+   writesnapshot("QPLIB_8938.model.snapshot", model);
+   CompactModel c = readsnapshot("QPLIB_8938.model.snapshot");
+   REQUIRE(c.colnames == m.colnames);
+   REQUIRE(c.value == m.value);
+   REQUIRE(c.objhessian.value == m.objhessian.value);
+
+   // truncated files are rejected
+   FILE* file = fopen("QPLIB_8938.snapshot", "rb");
+   std::vector<char> content(1 << 16);
+   size_t size = 0, n;
+   while ((n = fread(content.data() + size, 1, content.size() - size, file)) > 0) {
+      size += n;
+      content.resize(2 * content.size());
+   }
+   fclose(file);
+   file = fopen("QPLIB_8938.snapshot", "wb");
+   fwrite(content.data(), 1, size - 8, file);
+   fclose(file);
+   REQUIRE_THROWS_AS(readsnapshot("QPLIB_8938.snapshot"), std::invalid_argument);
+   REQUIRE_THROWS_AS(readsnapshot(filename), std::invalid_argument);
+}
+
+TEST_CASE( "snapshot", "" ) {
+   test_snapshot();
+}
+
+void test_cache() {
+   std::string filename = std::string(PROJECT_DIR) + "/check/qap10.lp";
+   ReaderOptions options;
+   options.cachedirectory = "parsecache";
+
+   // the first read fills the cache, the second one is served from it
+   ParseCache cache(options.cachedirectory, options.cachebudget);
+   cache.clear();
+   CompactModel m;
+   REQUIRE(!cache.lookup(filename, m));
+   m = readcompactinstance(filename);
+   cache.store(m);
+   CompactModel c;
+   REQUIRE(cache.lookup(filename, c));
+   REQUIRE(c.colnames == m.colnames);
+   REQUIRE(c.value == m.value);
+
+   Model model = readinstance(filename, options);
+   REQUIRE(model.variables.size() == m.ncols());
+   REQUIRE(model.constraints.size() == m.nrows());
+
+   // a copy has the same contents but another inode, it is found by its hash
+   writestring("qap10copy.lp", "");
+   FILE* in = fopen(filename.c_str(), "rb");
+   FILE* out = fopen("qap10copy.lp", "wb");
+   char buffer[4096];
+   size_t n;
+   while ((n = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+      fwrite(buffer, 1, n, out);
+   }
+   fclose(in);
+   fclose(out);
+   ParseCache copycache(options.cachedirectory, options.cachebudget);
+   REQUIRE(copycache.lookup("qap10copy.lp", c));
+
+   // with a tiny budget only the entry just written survives
+   ParseCache small(options.cachedirectory, 1);
+   REQUIRE(!small.lookup(std::string(PROJECT_DIR) + "/check/QPLIB_8938.lp", c));
+   small.store(readcompactinstance(std::string(PROJECT_DIR) + "/check/QPLIB_8938.lp"));
+   REQUIRE(small.lookup(std::string(PROJECT_DIR) + "/check/QPLIB_8938.lp", c));
+   REQUIRE(!small.lookup(filename, c));
+
+#ifndef _WIN32
+   // damaged entries are misses and are removed, the file is parsed again
+   ParseCache damaged(options.cachedirectory, options.cachebudget);
+   damaged.clear();
+   REQUIRE(!damaged.lookup(filename, c));
+   damaged.store(m);
+   std::vector<std::string> names;
+   DIR* dir = opendir(options.cachedirectory.c_str());
+   for (struct dirent* ent = readdir(dir); ent != nullptr; ent = readdir(dir)) {
+      names.push_back(options.cachedirectory + "/" + ent->d_name);
+   }
+   closedir(dir);
+   for (const std::string& name : names) {
+      if (name.size() > 5 && name.compare(name.size() - 5, 5, ".snap") == 0) {
+         std::string content = readfile(name);
+         uint32_t ncols = 0;
+         memcpy(&content[offsetof(SnapshotHeader, ncols)], &ncols, sizeof(ncols));
+         FILE* file = fopen(name.c_str(), "wb");
+         fwrite(content.data(), 1, content.size(), file);
+         fclose(file);
+         REQUIRE(!damaged.lookup(filename, c));
+         REQUIRE(fopen(name.c_str(), "rb") == nullptr);
+         damaged.store(m);
+         REQUIRE(damaged.lookup(filename, c));
+      }
+   }
+
+   // a malformed key is never used to build a path
+   for (const std::string& name : names) {
+      if (name.size() > 5 && name.compare(name.size() - 5, 5, ".stat") == 0) {
+         writestring(name, "../../check/qap10");
+         REQUIRE(damaged.lookup(filename, c));
+         REQUIRE(c.value == m.value);
+      }
+   }
+   Model cached = readinstance(filename, options);
+   REQUIRE(cached.constraints.size() == m.nrows());
+#endif
+}
+
+TEST_CASE( "cache", "" ) {
+   test_cache();
+}
+
+void test_lexnumber() {
+   // lexnumber must agree bit for bit with strtod, including the characters consumed
+   std::mt19937 rng(42);
+   for (unsigned int t=0; t<200000; t++) {
+      std::string number;
+      unsigned int ndigits = 1 + rng() % 24;
+      unsigned int point = rng() % (ndigits + 2);
+      for (unsigned int d=0; d<ndigits; d++) {
+         if (d == point) {
+            number += '.';
+         }
+         number += (char)('0' + rng() % 10);
+      }
+      if (rng() % 2) {
+         number += (rng() % 2) ? 'e' : 'E';
+         if (rng() % 2) {
+            number += (rng() % 2) ? '+' : '-';
+         }
+         number += std::to_string(rng() % (t % 10 == 0 ? 400 : 30));
+      }
+      number += " x1";
+
+      char* endptr;
+      double expected = strtod(number.c_str(), &endptr);
+      double value;
+      const char* end = lexnumber(number.c_str(), number.c_str() + number.size(), value);
+      REQUIRE(end == endptr);
+      REQUIRE(memcmp(&value, &expected, sizeof(double)) == 0);
+   }
+}
+
+TEST_CASE( "lexnumber", "" ) {
+   test_lexnumber();
+}
+
+void test_formatdouble() {
+   // every finite double is written so that it reads back unchanged
+   std::mt19937_64 rng(11);
+   std::vector<double> values = {0.0, -0.0, 1.0, -1.0, 0.1, 1e21, 1e22, 1e-7, 123456789012345.0,
+      1e15, 5e-324, 2.2250738585072014e-308, 1.7976931348623157e308};
+   for (unsigned int t=0; t<200000; t++) {
+      uint64_t bits = rng();
+      double value;
+      memcpy(&value, &bits, sizeof(value));
+      if (std::isfinite(value)) {
+         values.push_back(value);
+      }
+      values.push_back((double)(int64_t)(bits % 2000001) - 1000000.0);
+      values.push_back(((double)(int64_t)(bits % 2000001) - 1000000.0) / 1024.0);
+   }
+   for (size_t i=0; i<values.size(); i++) {
+      char buffer[LP_MAX_NUMBER_LENGTH];
+      char* end = formatdouble(values[i], buffer);
+      REQUIRE(end - buffer <= LP_MAX_NUMBER_LENGTH);
+      double value;
+      const char* start = buffer[0] == '-' ? buffer + 1 : buffer;
+      REQUIRE(lexnumber(start, end, value) == end);
+      if (start != buffer) {
+         value = -value;
+      }
+      REQUIRE(memcmp(&value, &values[i], sizeof(double)) == 0);
+   }
+
+   char buffer[LP_MAX_NUMBER_LENGTH];
+   REQUIRE(std::string(buffer, formatdouble(0.1, buffer)) == "0.1");
+   REQUIRE(std::string(buffer, formatdouble(-250.0, buffer)) == "-250");
+   REQUIRE(std::string(buffer, formatdouble(1e-7, buffer)) == "1e-7");
+   REQUIRE(std::string(buffer, formatdouble(1.5e300, buffer)) == "1.5e+300");
+   REQUIRE(std::string(buffer, formatdouble(0.30000000000000004, buffer)) == "0.30000000000000004");
+}
+
+TEST_CASE( "formatdouble", "" ) {
+   test_formatdouble();
+}
+
+void test_writerroundtrip() {
+   // values survive writing and reading back bit for bit
+   std::string filename = std::string(PROJECT_DIR) + "/check/QPLIB_8938.lp";
+   CompactModel m1 = readcompactinstance(filename);
+   writeinstance("roundtrip.lp", readinstance(filename));
+   CompactModel m2 = readcompactinstance("roundtrip.lp");
+   REQUIRE(m1.colnames == m2.colnames);
+   REQUIRE(m1.collower == m2.collower);
+   REQUIRE(m1.colupper == m2.colupper);
+   REQUIRE(m1.objindex == m2.objindex);
+   REQUIRE(m1.objvalue == m2.objvalue);
+   REQUIRE(m1.objhessian.index == m2.objhessian.index);
+   REQUIRE(m1.objhessian.value == m2.objhessian.value);
+   REQUIRE(m1.rowstart == m2.rowstart);
+   REQUIRE(m1.colindex == m2.colindex);
+   REQUIRE(m1.value == m2.value);
+   REQUIRE(m1.rowlower == m2.rowlower);
+   REQUIRE(m1.rowupper == m2.rowupper);
+}
+
+TEST_CASE( "writerroundtrip", "" ) {
+   test_writerroundtrip();
+}
+
+void test_parallelwriter() {
+   // large enough for several rounds of chunks, with rows longer than a line
+   Model m = readstring("parallelwriter.lp", "min\n obj: x0\nst\nend\n");
+   for (unsigned int i=0; i<20000; i++) {
+      m.variables.push_back(std::shared_ptr<Variable>(new Variable("y" + std::to_string(i))));
+      m.variables.back()->type = i % 3 == 0 ? VariableType::BINARY : VariableType::GENERAL;
+   }
+   std::mt19937 rng(5);
+   for (unsigned int i=0; i<6000; i++) {
+      std::shared_ptr<Constraint> con = std::shared_ptr<Constraint>(new Constraint);
+      unsigned int length = rng() % (i % 100 == 0 ? 400 : 40);
+      for (unsigned int k=0; k<length; k++) {
+         std::shared_ptr<LinTerm> term = std::shared_ptr<LinTerm>(new LinTerm);
+         term->var = m.variables[rng() % m.variables.size()];
+         term->coef = (double)rng() / 1000.0;
+         con->expr->linterms.push_back(term);
+      }
+      con->upperbound = i;
+      m.constraints.push_back(con);
+   }
+
+   writeinstance("serial.lp", m);
+   std::string serial = readfile("serial.lp");
+   for (unsigned int nthreads : {2, 3, 8}) {
+      WriterOptions options;
+      options.nthreads = nthreads;
+      writeinstance("parallel.lp", m, options);
+      REQUIRE(readfile("parallel.lp") == serial);
+   }
+
+   Model q = readinstance(std::string(PROJECT_DIR) + "/check/QPLIB_8938.lp");
+   writeinstance("serial.lp", q);
+   WriterOptions options;
+   options.nthreads = 4;
+   writeinstance("parallel.lp", q, options);
+   REQUIRE(readfile("parallel.lp") == readfile("serial.lp"));
+}
+
+TEST_CASE( "parallelwriter", "" ) {
+   test_parallelwriter();
+}
+
+void test_parallelreader() {
+   // rows with and without names, quadratic parts and new variables
+   // throughout, so that every chunk numbers variables of its own
+   std::mt19937 rng(7);
+   std::string content = "max\n obj: 2 x0 + [ x0^2 + 3 x0 * x1 ]/2\nsubject to\n";
+   for (unsigned int i=0; i<30000; i++) {
+      if (i % 7 != 3) {
+         content += " c" + std::to_string(i) + ": ";
+      }
+      unsigned int length = 1 + rng() % 12;
+      for (unsigned int k=0; k<length; k++) {
+         content += (k > 0 ? " + " : "") + std::to_string(rng() % 100) + " x" + std::to_string(rng() % (i + 10));
+      }
+      if (i % 50 == 0) {
+         content += " + [ 2 x" + std::to_string(i) + " * x1 - x1 * x" + std::to_string(i) + " + x" + std::to_string(i) + "^2 ]/2";
+      }
+      content += (i % 3 == 0 ? " <= " : i % 3 == 1 ? " >= -" : " = ") + std::to_string(i) + "\n";
+   }
+   content += "bounds\n x1 free\n -5 <= x2 <= 5\nbinaries\n x3\nend\n";
+   writestring("parallelreader.lp", content);
+
+   CompactModel serial = readcompactinstance("parallelreader.lp");
+   writesnapshot("parallelreader.serial.snapshot", serial);
+   for (unsigned int nthreads : {2, 3, 8, 0}) {
+      ReaderOptions options;
+      options.nthreads = nthreads;
+      CompactModel parallel = readcompactinstance("parallelreader.lp", options);
+      writesnapshot("parallelreader.parallel.snapshot", parallel);
+      REQUIRE(readfile("parallelreader.parallel.snapshot") == readfile("parallelreader.serial.snapshot"));
+   }
+
+   // rows without names are split as well, after the line that ends a row,
+   // but not after the first bound of a ranged row
+   std::string unnamed = "min\n obj: x0\nst\n";
+   for (unsigned int i=0; i<30000; i++) {
+      if (i % 5 == 0) {
+         unnamed += " -" + std::to_string(i) + " <= " + std::to_string(i % 7 + 1) + "\n x" + std::to_string(i % 100) + " <= " + std::to_string(i) + "\n";
+      } else {
+         unnamed += " x" + std::to_string(i % 100) + " + " + std::to_string(i % 9) + " y" + std::to_string(i) + (i % 2 ? " >= -" : " <= ") + std::to_string(i) + "\n";
+      }
+   }
+   unnamed += "end\n";
+   writestring("parallelreader.lp", unnamed);
+   writesnapshot("parallelreader.serial.snapshot", readcompactinstance("parallelreader.lp"));
+   ParseStats stats;
+   ReaderOptions unnamedoptions;
+   unnamedoptions.nthreads = 4;
+   unnamedoptions.stats = &stats;
+   writesnapshot("parallelreader.parallel.snapshot", readcompactinstance("parallelreader.lp", unnamedoptions));
+   REQUIRE(readfile("parallelreader.parallel.snapshot") == readfile("parallelreader.serial.snapshot"));
+   unsigned int maxthread = 0;
+   for (const ParseEvent& event : stats.events) {
+      maxthread = std::max(maxthread, event.thread);
+   }
+   REQUIRE(maxthread == 4);
+
+   // comments within rows do not end them, wherever they are
+   std::string commented = "min\n obj: x0\nst\n";
+   for (unsigned int i=0; i<40000; i++) {
+      std::string name = "r" + std::to_string(i);
+      switch (i % 4) {
+         case 0:
+            commented += " " + name + ": x" + std::to_string(i % 100) + " + y \\ note z <= 1\n + w" + std::to_string(i) + " >= 2\n";
+            break;
+         case 1:
+            commented += " " + name + ": x" + std::to_string(i % 100) + " + y\n\\ was: z <= 1\n + w" + std::to_string(i) + " >= 2\n";
+            break;
+         case 2:
+            commented += " x" + std::to_string(i % 100) + " - y <= 1\n  \\ r: x <= 1\n <= 3\n";
+            break;
+         default:
+            commented += " -1 <= y \\ c: x >= 1\n + w" + std::to_string(i) + " <= 4 \\ ends here\n";
+            break;
+      }
+   }
+   commented += "end\n";
+   writestring("parallelreader.lp", commented);
+   writesnapshot("parallelreader.serial.snapshot", readcompactinstance("parallelreader.lp"));
+   for (unsigned int nthreads : {2, 8}) {
+      ReaderOptions commentoptions;
+      commentoptions.nthreads = nthreads;
+      writesnapshot("parallelreader.parallel.snapshot", readcompactinstance("parallelreader.lp", commentoptions));
+      REQUIRE(readfile("parallelreader.parallel.snapshot") == readfile("parallelreader.serial.snapshot"));
+   }
+
+   // errors within the constraint section are still found
+   ReaderOptions options;
+   options.nthreads = 4;
+   writestring("parallelreader.lp", content.substr(0, content.size() / 4 * 3) + "\n c: x <> 1\n");
+   REQUIRE_THROWS_AS(readcompactinstance("parallelreader.lp", options), std::invalid_argument);
+}
+
+TEST_CASE( "parallelreader", "" ) {
+   test_parallelreader();
+}
+
+void test_parsestats() {
+   std::string filename = std::string(PROJECT_DIR) + "/check/qap10.lp";
+   CompactModel m = readcompactinstance(filename);
+
+   ParseStats stats;
+   ReaderOptions options;
+   options.stats = &stats;
+   Model model = readinstance(filename, options);
+   REQUIRE(stats.bytes == readfile(filename).size());
+   REQUIRE(stats.variables == m.ncols());
+   REQUIRE(stats.constraints == m.nrows());
+   REQUIRE(stats.nonzeros == m.nnz());
+   REQUIRE(stats.rawtokens > stats.processedtokens);
+   REQUIRE(stats.processedtokens > 0);
+   REQUIRE(stats.tokenmemory > 0);
+   REQUIRE(stats.consectime > 0.0);
+   REQUIRE(stats.createmodeltime > 0.0);
+   double phases = stats.iotime + stats.tokenizetime + stats.processtokenstime + stats.splittokenstime
+      + stats.objsectime + stats.consectime + stats.boundssectime + stats.gensectime + stats.binsectime
+      + stats.semisectime + stats.sossectime + stats.finishtime + stats.createmodeltime;
+   REQUIRE(phases <= stats.totaltime);
+
+   std::map<std::string, unsigned int> events;
+   for (const ParseEvent& event : stats.events) {
+      events[event.name]++;
+      REQUIRE(event.start >= 0.0);
+      REQUIRE(event.start + event.duration <= stats.totaltime);
+   }
+   REQUIRE(events["objective"] == 1);
+   REQUIRE(events["constraints"] == 1);
+   REQUIRE(events["bounds"] == 1);
+   REQUIRE(events["create model"] == 1);
+
+   writetrace("qap10.trace.json", stats);
+   std::string trace = readfile("qap10.trace.json");
+   REQUIRE(trace.compare(0, 15, "{\"traceEvents\":") == 0);
+   REQUIRE(trace.find("\"name\":\"constraints\"") != std::string::npos);
+
+   // the counts do not depend on the number of threads
+   ParseStats parallel;
+   options.stats = &parallel;
+   options.nthreads = 4;
+   readcompactinstance(filename, options);
+   REQUIRE(parallel.rawtokens == stats.rawtokens);
+   REQUIRE(parallel.processedtokens == stats.processedtokens);
+   REQUIRE(parallel.variables == stats.variables);
+   REQUIRE(parallel.nonzeros == stats.nonzeros);
+}
+
+TEST_CASE( "parsestats", "" ) {
+   test_parsestats();
+}
+
+void test_compression() {
+   // large enough to be decompressed in many steps, with some long lines
+   std::mt19937 rng(11);
+   std::string content = "min\n obj: x0 + [ x0^2 ]/2\nst\n";
+   for (unsigned int i=0; i<40000; i++) {
+      content += " c" + std::to_string(i) + ":";
+      unsigned int length = 1 + rng() % (i % 1000 == 0 ? 3000 : 8);
+      for (unsigned int k=0; k<length; k++) {
+         content += " + " + std::to_string(rng() % 100) + " x" + std::to_string(rng() % 5000);
+      }
+      content += " <= " + std::to_string(i) + "\n";
+   }
+   content += "bounds\n x1 free\nend\n";
+   Model m = readstring("compression.lp", content);
+   writeinstance("compression.lp", m);
+   CompactModel plain = readcompactinstance("compression.lp");
+   writesnapshot("compression.plain.snapshot", plain);
+
+   for (Compression compression : {Compression::GZIP, Compression::ZSTD}) {
+      if (!supportscompression(compression)) {
+         continue;
+      }
+      WriterOptions writeroptions;
+      writeroptions.compression = compression;
+      writeroptions.nthreads = 2;
+      writeinstance("compression.lp.z", m, writeroptions);
+      std::string compressed = readfile("compression.lp.z");
+      REQUIRE(compressed.size() < readfile("compression.lp").size() / 2);
+      REQUIRE(detectcompression(compressed.data(), compressed.size()) == compression);
+
+      for (unsigned int nthreads : {1, 4}) {
+         ReaderOptions options;
+         options.nthreads = nthreads;
+         writesnapshot("compression.snapshot", readcompactinstance("compression.lp.z", options));
+         REQUIRE(readfile("compression.snapshot") == readfile("compression.plain.snapshot"));
+      }
+
+      // input that ends early is an error rather than a shorter model
+      writestring("compression.lp.z", compressed.substr(0, compressed.size() / 2));
+      REQUIRE_THROWS_AS(readcompactinstance("compression.lp.z"), std::invalid_argument);
+      writestring("compression.lp.z", compressed.substr(0, 8) + "garbage");
+      REQUIRE_THROWS_AS(readcompactinstance("compression.lp.z"), std::invalid_argument);
+   }
+}
+
+TEST_CASE( "compression", "" ) {
+   test_compression();
+}
+
+void test_memoryinput() {
+   std::string filename = std::string(PROJECT_DIR) + "/check/QPLIB_8938.lp";
+   writesnapshot("memoryinput.file.snapshot", readcompactinstance(filename));
+   std::string expected = readfile("memoryinput.file.snapshot");
+   std::string content = readfile(filename);
+
+   // the buffer is not null-terminated
+   std::vector<char> buffer(content.begin(), content.end());
+   writesnapshot("memoryinput.snapshot", readcompactinstance(buffer.data(), buffer.size()));
+   REQUIRE(readfile("memoryinput.snapshot") == expected);
+
+   ParseStats stats;
+   ReaderOptions options;
+   options.nthreads = 2;
+   options.stats = &stats;
+   Model m = readinstance(buffer.data(), buffer.size(), options);
+   REQUIRE(m.variables.size() == stats.variables);
+   REQUIRE(stats.bytes == buffer.size());
+
+   std::istringstream stream(content);
+   writesnapshot("memoryinput.snapshot", readcompactinstance(stream));
+   REQUIRE(readfile("memoryinput.snapshot") == expected);
+   std::ifstream file(filename, std::ios::binary);
+   writesnapshot("memoryinput.snapshot", readcompactinstance(file, options));
+   REQUIRE(readfile("memoryinput.snapshot") == expected);
+   REQUIRE(stats.bytes == content.size());
+
+   if (supportscompression(Compression::GZIP)) {
+      WriterOptions writeroptions;
+      writeroptions.compression = Compression::GZIP;
+      writeinstance("memoryinput.lp.gz", readinstance(filename), writeroptions);
+      writesnapshot("memoryinput.file.snapshot", readcompactinstance("memoryinput.lp.gz"));
+      std::string compressed = readfile("memoryinput.lp.gz");
+      writesnapshot("memoryinput.snapshot", readcompactinstance(compressed.data(), compressed.size()));
+      REQUIRE(readfile("memoryinput.snapshot") == readfile("memoryinput.file.snapshot"));
+   }
+
+   std::string garbage = "min\n obj: x <> y\nend\n";
+   REQUIRE_THROWS_AS(readinstance(garbage.data(), garbage.size()), std::invalid_argument);
+   std::istringstream garbagestream(garbage);
+   REQUIRE_THROWS_AS(readinstance(garbagestream), std::invalid_argument);
+}
+
+TEST_CASE( "memoryinput", "" ) {
+   test_memoryinput();
+}
+
+// rebuilds the parts of a compact model that can be compared without the hessians
+class CollectingHandler : public ParseHandler {
+public:
+   ObjectiveSense objsense = ObjectiveSense::MIN;
+   std::vector<std::string> names;
+   std::vector<double> lower, upper;
+   std::vector<VariableType> types;
+   std::vector<uint32_t> objindex;
+   std::vector<double> objvalue;
+   size_t objquadterms = 0;
+   std::vector<uint32_t> colindex;
+   std::vector<double> value;
+   std::vector<double> rowlower, rowupper;
+   std::string rowname;
+   std::vector<std::string> rownames;
+   size_t quadrows = 0;
+   bool inrow = false;
+   bool quadrow = false;
+   bool ended = false;
+
+   void sense(ObjectiveSense sense) { objsense = sense; }
+   void newvariable(uint32_t var, const char* name, size_t length) {
+      REQUIRE(var == names.size());
+      names.push_back(std::string(name, length));
+      lower.push_back(0.0);
+      upper.push_back(std::numeric_limits<double>::infinity());
+      types.push_back(VariableType::CONTINUOUS);
+   }
+   void objectiveterm(uint32_t var, double coef) {
+      objindex.push_back(var);
+      objvalue.push_back(coef);
+   }
+   void objectivequadterm(uint32_t, uint32_t, double) { objquadterms++; }
+   void constraintbegin(const char* name, size_t length) {
+      REQUIRE(!inrow);
+      inrow = true;
+      quadrow = false;
+      rownames.push_back(std::string(name, length));
+   }
+   void constraintterm(uint32_t var, double coef) {
+      REQUIRE(var < names.size());
+      colindex.push_back(var);
+      value.push_back(coef);
+   }
+   void constraintquadterm(uint32_t, uint32_t, double) { quadrow = true; }
+   void constraintend(double lowerbound, double upperbound, double) {
+      inrow = false;
+      quadrows += quadrow;
+      rowlower.push_back(lowerbound);
+      rowupper.push_back(upperbound);
+   }
+   void variablebound(uint32_t var, double lowerbound, double upperbound) {
+      lower[var] = lowerbound;
+      upper[var] = upperbound;
+   }
+   void variabletype(uint32_t var, VariableType type) { types[var] = type; }
+   void end() { ended = true; }
+};
+
+void test_handler() {
+   for (std::string name : {"QPLIB_8938.lp", "qap10.lp"}) {
+      std::string filename = std::string(PROJECT_DIR) + "/check/" + name;
+      CompactModel m = readcompactinstance(filename);
+      CollectingHandler handler;
+      readinstance(filename, handler);
+
+      REQUIRE(handler.ended);
+      REQUIRE(handler.objsense == m.sense);
+      REQUIRE(handler.names.size() == m.ncols());
+      for (uint32_t j=0; j<m.ncols(); j++) {
+         REQUIRE(handler.names[j] == m.colname(j));
+      }
+      REQUIRE(handler.lower == m.collower);
+      REQUIRE(handler.upper == m.colupper);
+      REQUIRE(handler.types == m.coltype);
+      REQUIRE(handler.objindex == m.objindex);
+      REQUIRE(handler.objvalue == m.objvalue);
+      REQUIRE((handler.objquadterms > 0) == (m.objhessian.nnz() > 0));
+      REQUIRE(handler.colindex == m.colindex);
+      REQUIRE(handler.value == m.value);
+      REQUIRE(handler.rowlower == m.rowlower);
+      REQUIRE(handler.rowupper == m.rowupper);
+      REQUIRE(handler.quadrows == m.quadrows.size());
+      REQUIRE(handler.rownames.size() == m.nrows());
+   }
+
+   std::string garbage = "min\n obj: x\nst\n c: x <> 1\nend\n";
+   CollectingHandler handler;
+   REQUIRE_THROWS_AS(readinstance(garbage.data(), garbage.size(), handler), std::invalid_argument);
+   REQUIRE(!handler.ended);
+}
+
+TEST_CASE( "handler", "" ) {
+   test_handler();
+}
+
+void test_incremental() {
+   std::string filename = std::string(PROJECT_DIR) + "/check/QPLIB_8938.lp";
+   writesnapshot("incremental.file.snapshot", readcompactinstance(filename));
+   std::string expected = readfile("incremental.file.snapshot");
+   std::string content = readfile(filename);
+
+   // pieces end within numbers, names and keywords
+   std::mt19937 rng(13);
+   for (unsigned int maxlength : {1, 7, 1000, 100000}) {
+      ReaderOptions options;
+      options.nthreads = maxlength % 2 == 0 ? 2 : 1;
+      IncrementalReader reader(options);
+      size_t pos = 0;
+      while (pos < content.size()) {
+         size_t length = std::min(content.size() - pos, (size_t)(1 + rng() % maxlength));
+         reader.feed(content.data() + pos, length);
+         pos += length;
+      }
+      writesnapshot("incremental.snapshot", reader.finish());
+      REQUIRE(readfile("incremental.snapshot") == expected);
+   }
+
+   // a single line far longer than any piece
+   std::string longline = "min\n obj:";
+   for (unsigned int i=0; i<200000; i++) {
+      longline += " + " + std::to_string(i % 10) + " x" + std::to_string(i);
+   }
+   longline += "\nend";
+   IncrementalReader reader;
+   for (size_t pos=0; pos<longline.size(); pos+=4096) {
+      reader.feed(longline.data() + pos, std::min((size_t)4096, longline.size() - pos));
+   }
+   CompactModel m = reader.finish();
+   REQUIRE(m.ncols() == 200000);
+   REQUIRE(m.objvalue[199999] == 9.0);
+
+   if (supportscompression(Compression::GZIP)) {
+      WriterOptions writeroptions;
+      writeroptions.compression = Compression::GZIP;
+      writeinstance("incremental.lp.gz", readinstance(filename), writeroptions);
+      writesnapshot("incremental.file.snapshot", readcompactinstance("incremental.lp.gz"));
+      std::string compressed = readfile("incremental.lp.gz");
+      IncrementalReader compressedreader;
+      for (size_t pos=0; pos<compressed.size(); pos+=3) {
+         compressedreader.feed(compressed.data() + pos, std::min((size_t)3, compressed.size() - pos));
+      }
+      writesnapshot("incremental.snapshot", compressedreader.finish());
+      REQUIRE(readfile("incremental.snapshot") == readfile("incremental.file.snapshot"));
+   }
+
+   // errors show up with a later piece or at the latest with finish
+   std::string garbage = "min\n obj: x\nst\n c: x <> 1\n";
+   bool thrown = false;
+   try {
+      IncrementalReader garbagereader;
+      garbagereader.feed(garbage.data(), garbage.size());
+      for (unsigned int i=0; i<100; i++) {
+         garbagereader.feed(content.data(), 1000);
+      }
+      garbagereader.finish();
+   } catch (const std::invalid_argument&) {
+      thrown = true;
+   }
+   REQUIRE(thrown);
+
+   // abandoned without finish
+   IncrementalReader abandoned;
+   abandoned.feed(content.data(), content.size() / 2);
+}
+
+TEST_CASE( "incremental", "" ) {
+   test_incremental();
+}
+
+void test_streamgrowth() {
+   std::string content;
+   for (unsigned int i=0; i<50000; i++) {
+      content += " c" + std::to_string(i) + ": x" + std::to_string(i % 100) + " <= " + std::to_string(i) + "\n";
+   }
+
+   // far more input than first reserved, which grows in place of the push
+   // while no reader waits
+   PushInput unread(4096);
+   for (size_t pos=0; pos<content.size(); pos+=1000) {
+      REQUIRE(unread.push(content.data() + pos, std::min((size_t)1000, content.size() - pos)));
+   }
+   unread.finish();
+   REQUIRE(std::string(unread.begin(), unread.waitall()) == content);
+
+   // with a reader, in its waits, after which it takes the start again
+   PushInput input(4096);
+   std::string read;
+   std::thread reader([&]() {
+      size_t end = 0;
+      size_t available;
+      while ((available = input.wait(end)) > end) {
+         read.append(input.begin() + end, available - end);
+         end = available;
+      }
+   });
+   for (size_t pos=0; pos<content.size(); pos+=777) {
+      REQUIRE(input.push(content.data() + pos, std::min((size_t)777, content.size() - pos)));
+   }
+   input.finish();
+   reader.join();
+   REQUIRE(read == content);
+}
+
+TEST_CASE( "streamgrowth", "" ) {
+   test_streamgrowth();
+}
+
+void test_batch() {
+   std::vector<std::string> filenames;
+   for (std::string name : {"qap10.lp", "QPLIB_8938.lp", "garbage.lp", "qap10.lp", "missing.lp"}) {
+      filenames.push_back(std::string(PROJECT_DIR) + "/check/" + name);
+   }
+
+   ReaderOptions options;
+   options.nthreads = 3;
+   std::vector<unsigned int> calls(filenames.size(), 0);
+   std::mutex mutex;
+   readcompactinstances(filenames, options, [&](size_t i, CompactModel& m, std::exception_ptr error) {
+      std::lock_guard<std::mutex> lock(mutex);
+      calls[i]++;
+      bool invalid = i == 2 || i == 4;
+      REQUIRE((error != nullptr) == invalid);
+      if (!invalid) {
+         writesnapshot("batch.snapshot", m);
+         writesnapshot("batch.file.snapshot", readcompactinstance(filenames[i]));
+         REQUIRE(readfile("batch.snapshot") == readfile("batch.file.snapshot"));
+      }
+   });
+   REQUIRE(calls == std::vector<unsigned int>(filenames.size(), 1));
+
+   REQUIRE_THROWS_AS(readinstances(filenames, options), std::invalid_argument);
+   filenames.resize(2);
+   options.nthreads = 0;
+   std::vector<Model> models = readinstances(filenames, options);
+   REQUIRE(models.size() == 2);
+   REQUIRE(models[0].variables.size() == readcompactinstance(filenames[0]).ncols());
+   REQUIRE(models[1].constraints.size() == readcompactinstance(filenames[1]).nrows());
+   REQUIRE(readinstances(std::vector<std::string>(), options).empty());
+}
+
+TEST_CASE( "batch", "" ) {
+   test_batch();
+}
+
+void test_lexkeyword() {
+   std::string names[] = {"min", "MAXIMIZE", "Minimum", "st", "S.T.", "bound", "Bounds", "inf", "Infinity", "free", "gen", "generals", "binaries", "bin", "semi", "SEMIS", "sos", "End"};
+   LpKeyword keywords[] = {LpKeyword::MIN, LpKeyword::MAX, LpKeyword::MIN, LpKeyword::ST, LpKeyword::ST, LpKeyword::BOUNDS, LpKeyword::BOUNDS, LpKeyword::INF, LpKeyword::INF, LpKeyword::FREE, LpKeyword::GEN, LpKeyword::GEN, LpKeyword::BIN, LpKeyword::BIN, LpKeyword::SEMI, LpKeyword::SEMI, LpKeyword::SOS, LpKeyword::END};
+   for (unsigned int i=0; i<sizeof(keywords) / sizeof(keywords[0]); i++) {
+      REQUIRE(lexkeyword(names[i].data(), names[i].size()) == keywords[i]);
+   }
+   for (std::string name : {"x123", "mins", "mi", "m", "", "subject", "minimizer", "infinityy", "ende", "s.t", "frei"}) {
+      REQUIRE(lexkeyword(name.data(), name.size()) == LpKeyword::NONE);
+   }
+
+   REQUIRE(lexkeyword("Subject", 7, ' ', "TO", 2) == LpKeyword::ST);
+   REQUIRE(lexkeyword("such", 4, ' ', "that", 4) == LpKeyword::ST);
+   REQUIRE(lexkeyword("SEMI", 4, '-', "continuous", 10) == LpKeyword::SEMI);
+   REQUIRE(lexkeyword("semi", 4, ' ', "continuous", 10) == LpKeyword::NONE);
+   REQUIRE(lexkeyword("subject", 7, '-', "to", 2) == LpKeyword::NONE);
+   REQUIRE(lexkeyword("x1", 2, ' ', "x2", 2) == LpKeyword::NONE);
+
+   Model m = readstring("lexkeyword.lp", "MAXIMUM\n obj: x + y + z\nSUCH THAT\n c: x + y <= +INF\nBOUND\n x FREE\n y <= Infinity\nSEMI-CONTINUOUS\n z\nEND\n");
+   REQUIRE(m.sense == ObjectiveSense::MAX);
+   REQUIRE(m.constraints.size() == 1);
+   REQUIRE(m.variables[2]->type == VariableType::SEMICONTINUOUS);
+}
+
+TEST_CASE( "lexkeyword", "" ) {
+   test_lexkeyword();
+}
+
+void test_headercounts() {
+   // the header of QPLIB_8938.lp is right, the others must not matter either
+   std::string filename = std::string(PROJECT_DIR) + "/check/QPLIB_8938.lp";
+   writesnapshot("headercounts.file.snapshot", readcompactinstance(filename));
+   std::string expected = readfile("headercounts.file.snapshot");
+   std::string content = readfile(filename);
+   std::string body = content.substr(content.find("Minimize"));
+
+   std::string headers[] = {
+      "",
+      "\\ Equation counts\n\\     Total\n\\     1\n\\ Variable counts\n\\     Total\n\\     2\n\\ Nonzero counts\n\\     Total\n\\     3\n",
+      "\\ Equation counts\n\\     Total\n\\     99999999999999999999\n\\ Variable counts\n\\     Total\n\\     4000000000\n\\ Nonzero counts\n\\ Total\n\\ 18446744073709551615\n",
+      "\\ Equation counts\n\\ Variable counts\n\\\n\\ Nonzero counts",
+      "\\Nonzero counts\r\n\\ -5\r\n\\ x\r\n",
+   };
+   for (const std::string& header : headers) {
+      writestring("headercounts.lp", header + "\n" + body);
+      writesnapshot("headercounts.snapshot", readcompactinstance("headercounts.lp"));
+      REQUIRE(readfile("headercounts.snapshot") == expected);
+   }
+
+   // however large the counts, all that is reserved stays within the bound,
+   // the symbol table included
+   const size_t maxbytes = 1 << 20;
+   Builder builder;
+   builder.reserve(1000000000, 2000000000, 3000000000u, maxbytes);
+   CompactModel& m = builder.model;
+   REQUIRE(m.colindex.capacity() > 0);
+   REQUIRE(m.rowlower.capacity() > 0);
+   REQUIRE(m.collower.capacity() > 0);
+   REQUIRE(builder.variables.memory() > m.collower.capacity() * SymbolTable::RESERVED_BYTES / 2);
+   size_t reserved = builder.variables.memory()
+      + (m.rowlower.capacity() + m.rowupper.capacity() + m.rowoffset.capacity() + m.collower.capacity() + m.colupper.capacity()) * sizeof(double)
+      + (m.rowstart.capacity() + m.rownamestart.capacity()) * sizeof(size_t) + m.coltype.capacity() * sizeof(VariableType)
+      + m.colindex.capacity() * sizeof(uint32_t) + m.value.capacity() * sizeof(double);
+   REQUIRE(reserved <= maxbytes + 1024);
+}
+
+TEST_CASE( "headercounts", "" ) {
+   test_headercounts();
+}
+
+void test_arena() {
+   std::string filename = std::string(PROJECT_DIR) + "/check/QPLIB_8938.lp";
+   Model plain = readinstance(filename);
+
+   // blocks smaller than some of the objects must work as well
+   for (size_t blocksize : {(size_t)64, (size_t)1 << 16}) {
+      ParseStats stats;
+      ReaderOptions options;
+      options.arenablocksize = blocksize;
+      options.stats = &stats;
+      ArenaModel read = readarenainstance(filename, options);
+      ArenaUsage usage = read.arena->usage();
+      REQUIRE(usage.blocks > 0);
+      REQUIRE(usage.used > 0);
+      REQUIRE(usage.used <= usage.reserved);
+      REQUIRE(stats.arenamemory == usage.reserved);
+
+      // moving keeps the objects where they are
+      ArenaVariable* first = read.variables[0];
+      ArenaModel model = std::move(read);
+      REQUIRE(read.arena == nullptr);
+      REQUIRE(model.variables[0] == first);
+
+      // the same as the Model
+      REQUIRE(model.sense == plain.sense);
+      REQUIRE(model.variables.size() == plain.variables.size());
+      for (size_t i=0; i<plain.variables.size(); i++) {
+         REQUIRE(plain.variables[i]->name == model.variables[i]->name.c_str());
+         REQUIRE(plain.variables[i]->type == model.variables[i]->type);
+         REQUIRE(plain.variables[i]->lowerbound == model.variables[i]->lowerbound);
+         REQUIRE(plain.variables[i]->upperbound == model.variables[i]->upperbound);
+      }
+      std::vector<std::pair<Expression*, ArenaExpression*>> expressions(1, std::make_pair(plain.objective.get(), model.objective));
+      REQUIRE(model.constraints.size() == plain.constraints.size());
+      for (size_t i=0; i<plain.constraints.size(); i++) {
+         REQUIRE(plain.constraints[i]->lowerbound == model.constraints[i]->lowerbound);
+         REQUIRE(plain.constraints[i]->upperbound == model.constraints[i]->upperbound);
+         expressions.push_back(std::make_pair(plain.constraints[i]->expr.get(), model.constraints[i]->expr));
+      }
+      for (size_t e=0; e<expressions.size(); e++) {
+         Expression& expr = *expressions[e].first;
+         ArenaExpression& arenaexpr = *expressions[e].second;
+         REQUIRE(expr.name == arenaexpr.name.c_str());
+         REQUIRE(expr.offset == arenaexpr.offset);
+         REQUIRE(expr.linterms.size() == arenaexpr.linterms.size());
+         for (size_t k=0; k<expr.linterms.size(); k++) {
+            REQUIRE(expr.linterms[k]->var->name == arenaexpr.linterms[k].var->name.c_str());
+            REQUIRE(expr.linterms[k]->coef == arenaexpr.linterms[k].coef);
+         }
+         REQUIRE(expr.quadterms.size() == arenaexpr.quadterms.size());
+         for (size_t k=0; k<expr.quadterms.size(); k++) {
+            REQUIRE(expr.quadterms[k]->var1->name == arenaexpr.quadterms[k].var1->name.c_str());
+            REQUIRE(expr.quadterms[k]->var2->name == arenaexpr.quadterms[k].var2->name.c_str());
+            REQUIRE(expr.quadterms[k]->coef == arenaexpr.quadterms[k].coef);
+         }
+      }
+
+      // copies do not depend on the arena
+      std::string name = model.variables[0]->name.c_str();
+      ArenaVariable copy = *model.variables[0];
+      REQUIRE(copy.name.get_allocator().arena == nullptr);
+      model = ArenaModel();
+      REQUIRE(name == copy.name.c_str());
+   }
+}
+
+TEST_CASE( "arena", "" ) {
+   test_arena();
+}
+
+void test_hexfloat() {
+   // lexnumber agrees with strtod on hexadecimal floats as well
+   std::mt19937_64 rng(7);
+   std::vector<std::string> numbers = {"0x", "0x.", "0x.p1", "0X1P-3", "0x1.", "0x.8", "0x1p", "0x1p+", "0xg",
+      "0x1.fffffffffffff8p+0", "0x123456789abcdef0123", "0x1p-1074", "0x1p-1080", "0x1.8p+1024", "0x0.00000000000001p0"};
+   for (unsigned int t=0; t<100000; t++) {
+      uint64_t bits = rng();
+      std::ostringstream number;
+      number << std::hex << (bits >> (bits % 64));
+      if (rng() % 2) {
+         number << "." << std::hex << (rng() >> (rng() % 64));
+      }
+      if (rng() % 2) {
+         number << ((rng() % 2) ? "p" : "P") << ((rng() % 2) ? "+" : "-") << std::dec << rng() % 1100;
+      }
+      numbers.push_back("0x" + number.str());
+   }
+   for (std::string& number : numbers) {
+      number += " x1";
+      char* endptr;
+      double expected = strtod(number.c_str(), &endptr);
+      double value;
+      const char* end = lexnumber(number.c_str(), number.c_str() + number.size(), value);
+      REQUIRE(end == endptr);
+      REQUIRE(memcmp(&value, &expected, sizeof(double)) == 0);
+   }
+
+   // and reads back every double formathexdouble writes
+   for (unsigned int t=0; t<200000; t++) {
+      uint64_t bits = t < 16 ? t : rng();
+      double value;
+      memcpy(&value, &bits, sizeof(value));
+      if (!std::isfinite(value)) {
+         continue;
+      }
+      char buffer[LP_MAX_NUMBER_LENGTH];
+      char* end = formathexdouble(value, buffer);
+      REQUIRE(end - buffer <= LP_MAX_NUMBER_LENGTH);
+      const char* start = buffer[0] == '-' ? buffer + 1 : buffer;
+      double read;
+      REQUIRE(lexnumber(start, end, read) == end);
+      if (start != buffer) {
+         read = -read;
+      }
+      REQUIRE(memcmp(&read, &value, sizeof(double)) == 0);
+   }
+   char buffer[LP_MAX_NUMBER_LENGTH];
+   REQUIRE(std::string(buffer, formathexdouble(3.0, buffer)) == "3");
+   REQUIRE(std::string(buffer, formathexdouble(-0.75, buffer)) == "-0x1.8p-1");
+   REQUIRE(std::string(buffer, formathexdouble(0.1, buffer)) == "0x1.999999999999ap-4");
+   REQUIRE(std::string(buffer, formathexdouble(5e-324, buffer)) == "0x0.0000000000001p-1022");
+
+   // a model written with hexadecimal floats reads back as with decimal ones
+   std::string filename = std::string(PROJECT_DIR) + "/check/QPLIB_8938.lp";
+   Model model = readinstance(filename);
+   writeinstance("hexfloat.plain.lp", model);
+   writesnapshot("hexfloat.plain.snapshot", readinstance("hexfloat.plain.lp"));
+   WriterOptions options;
+   options.hexfloat = true;
+   writeinstance("hexfloat.lp", model, options);
+   REQUIRE(readfile("hexfloat.lp").find("0x1.") != std::string::npos);
+   writesnapshot("hexfloat.snapshot", readinstance("hexfloat.lp"));
+   REQUIRE(readfile("hexfloat.snapshot") == readfile("hexfloat.plain.snapshot"));
+}
+
+TEST_CASE( "hexfloat", "" ) {
+   test_hexfloat();
+}
+
+void test_rangedrows() {
+   Model m = readstring("rangedrows.lp",
+      "min\n obj: x\n"
+      "st\n c1: -2 <= x + y <= 4\n 3 >= x - y\n >= -inf c3: 2 <=\n 3 x + 1 <= 5\n x + y >= 1\n -1 <= 2 x\n <= 1\n"
+      "end\n");
+   REQUIRE(m.constraints.size() == 5);
+   REQUIRE(m.constraints[0]->expr->name == "c1");
+   REQUIRE(m.constraints[0]->lowerbound == -2.0);
+   REQUIRE(m.constraints[0]->upperbound == 4.0);
+   REQUIRE(m.constraints[0]->expr->linterms.size() == 2);
+   REQUIRE(m.constraints[1]->lowerbound == -std::numeric_limits<double>::infinity());
+   REQUIRE(m.constraints[1]->upperbound == 3.0);
+   REQUIRE(m.constraints[2]->expr->name == "c3");
+   REQUIRE(m.constraints[2]->lowerbound == 2.0);
+   REQUIRE(m.constraints[2]->upperbound == 5.0);
+   REQUIRE(m.constraints[2]->expr->offset == 1.0);
+   REQUIRE(m.constraints[3]->lowerbound == 1.0);
+   REQUIRE(m.constraints[3]->upperbound == std::numeric_limits<double>::infinity());
+   REQUIRE(m.constraints[4]->lowerbound == -1.0);
+   REQUIRE(m.constraints[4]->upperbound == 1.0);
+   REQUIRE(m.constraints[4]->expr->linterms[0]->coef == 2.0);
+
+   // a constant before a single comparison is not the first bound of a ranged row
+   Model c = readstring("rangedrows.lp",
+      "min\n obj: x\nst\n c1: 0 <= 5\n c2: 1 <= 2\n c3: x <= 3\n c4: 2 >= -1\n c5: 0 <= 5\nbounds\n x <= 4\nend\n");
+   REQUIRE(c.constraints.size() == 5);
+   REQUIRE(c.constraints[0]->expr->name == "c1");
+   REQUIRE(c.constraints[0]->expr->linterms.empty());
+   REQUIRE(c.constraints[0]->lowerbound == -std::numeric_limits<double>::infinity());
+   REQUIRE(c.constraints[0]->upperbound == 5.0);
+   REQUIRE(c.constraints[1]->expr->name == "c2");
+   REQUIRE(c.constraints[1]->expr->offset == 1.0);
+   REQUIRE(c.constraints[1]->upperbound == 2.0);
+   REQUIRE(c.constraints[2]->expr->linterms.size() == 1);
+   REQUIRE(c.constraints[2]->upperbound == 3.0);
+   REQUIRE(c.constraints[3]->expr->offset == 2.0);
+   REQUIRE(c.constraints[3]->lowerbound == -1.0);
+   REQUIRE(c.constraints[4]->expr->name == "c5");
+   REQUIRE(c.constraints[4]->upperbound == 5.0);
+   REQUIRE(readstring("rangedrows.lp", "min\n obj: x\nst\n c1: 0 <= 5").constraints.size() == 1);
+
+   REQUIRE_THROWS_AS(readstring("rangedrows.lp", "min\n obj: x\nst\n 1 <= x >= 0\nend\n"), std::invalid_argument);
+   REQUIRE_THROWS_AS(readstring("rangedrows.lp", "min\n obj: x\nst\n 1 = x = 1\nend\n"), std::invalid_argument);
+
+   // a ranged row is written once and read back as a single row
+   writeinstance("rangedrows.out.lp", m);
+   std::string written = readfile("rangedrows.out.lp");
+   REQUIRE(written.find("-2 <= +1 x +1 y <= +4") != std::string::npos);
+   Model m2 = readinstance("rangedrows.out.lp");
+   REQUIRE(m2.constraints.size() == m.constraints.size());
+   for (size_t i=0; i<m.constraints.size(); i++) {
+      REQUIRE(m2.constraints[i]->lowerbound == m.constraints[i]->lowerbound);
+      REQUIRE(m2.constraints[i]->upperbound == m.constraints[i]->upperbound);
+   }
+}
+
+TEST_CASE( "rangedrows", "" ) {
+   test_rangedrows();
+}
+
+void test_snapshotdamage() {
+   // every damaged snapshot is rejected or reads back as a consistent model
+   writestring("snapshotdamage.lp",
+      "min\n obj: x + 2 y + [ x^2 + x * z ]/2\nst\n c1: x + y + z >= 1\n c2: [ y * z ]/2 + y <= 4\n"
+      "bounds\n 0 <= z <= 3\ngeneral\n y\nend\n");
+   writesnapshot("snapshotdamage.snapshot", readcompactinstance("snapshotdamage.lp"));
+   std::string content = readfile("snapshotdamage.snapshot");
+   const uint32_t words[] = {0xffffffffu, 0x7fffffffu, 5, 3, 1, 0};
+
+   // from the sense in the header on, every 4 bytes
+   for (size_t pos=offsetof(SnapshotHeader, sense); pos+4<=content.size(); pos+=4) {
+      for (uint32_t word : words) {
+         std::string damaged = content;
+         memcpy(&damaged[pos], &word, sizeof(word));
+         FILE* file = fopen("snapshotdamage.bad", "wb");
+         fwrite(damaged.data(), 1, damaged.size(), file);
+         fclose(file);
+
+         CompactModel r;
+         try {
+            r = readsnapshot("snapshotdamage.bad");
+         } catch (std::invalid_argument&) {
+            continue;
+         }
+         Model model = createmodel(r);
+         ColumnMatrix matrix = createcolumnmatrix(r, 1);
+         for (uint32_t col=0; col<r.ncols(); col++) {
+            REQUIRE(r.colname(col).size() <= r.colnames.size());
+         }
+         for (uint32_t row=0; row<r.nrows(); row++) {
+            REQUIRE(r.rowname(row).size() <= r.rownames.size());
+         }
+         REQUIRE(matrix.colstart.size() == r.ncols() + 1);
+      }
+   }
+}
+
+TEST_CASE( "snapshotdamage", "" ) {
+   test_snapshotdamage();
+}
+
+TEST_CASE( "longline", "" ) {
+   test_longline();
+}
+
 TEST_CASE( "writer", "" ) {
    test_writer();
 }
@@ -0,0 +1,36 @@
+#include "arena.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+ModelArena::ModelArena(size_t blocksize) : blocksize(blocksize) {
+}
+
+ModelArena::~ModelArena() {
+   for (size_t b=0; b<blocks.size(); b++) {
+      free(blocks[b]);
+   }
+}
+
+void* ModelArena::allocate(size_t size, size_t alignment) {
+   uintptr_t aligned = ((uintptr_t)pos + alignment - 1) & ~(uintptr_t)(alignment - 1);
+   if (pos == nullptr || aligned + size > (uintptr_t)end) {
+      // objects larger than a block get one of their own
+      size_t length = size + alignment > blocksize ? size + alignment : blocksize;
+      blocks.reserve(blocks.size() + 1);
+      char* block = (char*)malloc(length);
+      if (block == nullptr) {
+         throw std::bad_alloc();
+      }
+      blocks.push_back(block);
+      current.blocks++;
+      current.reserved += length;
+      pos = block;
+      end = block + length;
+      aligned = ((uintptr_t)pos + alignment - 1) & ~(uintptr_t)(alignment - 1);
+   }
+   pos = (char*)(aligned + size);
+   current.used += size;
+   return (void*)aligned;
+}
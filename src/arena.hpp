@@ -0,0 +1,76 @@
+#ifndef __READERLP_ARENA_HPP__
+#define __READERLP_ARENA_HPP__
+
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+// memory of an arena, in bytes
+struct ArenaUsage {
+   size_t blocks = 0;
+   size_t reserved = 0;    // allocated from the system
+   size_t used = 0;        // handed out to objects
+};
+
+// memory the objects of a model are allocated from, in large blocks. it is
+// only given back all at once, when the arena goes away, and the destructors
+// of the objects in it are not run.
+class ModelArena {
+private:
+   std::vector<char*> blocks;
+   size_t blocksize;
+   char* pos = nullptr;
+   char* end = nullptr;
+   ArenaUsage current;
+
+   ModelArena(const ModelArena&);
+   ModelArena& operator=(const ModelArena&);
+
+public:
+   ModelArena(size_t blocksize);
+   ~ModelArena();
+
+   void* allocate(size_t size, size_t alignment);
+
+   ArenaUsage usage() const { return current; }
+};
+
+// allocator of the names and term lists of an ArenaModel: from its arena if
+// it has one, otherwise from the heap. copies of them always go to the heap,
+// since they may outlive the arena, while moves keep the arena.
+template <typename T>
+class ArenaAllocator {
+public:
+   typedef T value_type;
+   typedef std::true_type propagate_on_container_move_assignment;
+   typedef std::true_type propagate_on_container_swap;
+
+   ModelArena* arena = nullptr;
+
+   ArenaAllocator() {}
+   ArenaAllocator(ModelArena* arena) : arena(arena) {}
+   template <typename U>
+   ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+   T* allocate(size_t n) {
+      if (arena != nullptr) {
+         return (T*)arena->allocate(n * sizeof(T), alignof(T));
+      }
+      return std::allocator<T>().allocate(n);
+   }
+   void deallocate(T* p, size_t n) {
+      if (arena == nullptr) {
+         std::allocator<T>().deallocate(p, n);
+      }
+   }
+
+   ArenaAllocator select_on_container_copy_construction() const { return ArenaAllocator(); }
+
+   template <typename U>
+   bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+   template <typename U>
+   bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.arena; }
+};
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef __READERLP_ARENAMODEL_HPP__
+#define __READERLP_ARENAMODEL_HPP__
+
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "arena.hpp"
+#include "model.hpp"
+
+// names and term lists of an ArenaModel
+typedef std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>> ArenaString;
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+// the objects of a Model, allocated from the arena of an ArenaModel. they
+// refer to each other by plain pointers, which are valid as long as the
+// ArenaModel is. their destructors are not run, the arena is freed at once.
+struct ArenaVariable {
+   VariableType type = VariableType::CONTINUOUS;
+   double lowerbound = 0.0;
+   double upperbound = std::numeric_limits<double>::infinity();
+   ArenaString name;
+
+   ArenaVariable(const ArenaAllocator<char>& allocator) : name(allocator) {};
+};
+
+struct ArenaLinTerm {
+   ArenaVariable* var = nullptr;
+   double coef = 1.0;
+};
+
+struct ArenaQuadTerm {
+   ArenaVariable* var1 = nullptr;
+   ArenaVariable* var2 = nullptr;
+   double coef = 1.0;
+};
+
+struct ArenaExpression {
+   ArenaVector<ArenaLinTerm> linterms;
+   ArenaVector<ArenaQuadTerm> quadterms;
+   double offset = 0.0;
+   ArenaString name;
+
+   ArenaExpression(const ArenaAllocator<char>& allocator) : linterms(allocator), quadterms(allocator), name(allocator) {};
+};
+
+struct ArenaConstraint {
+   double lowerbound = -std::numeric_limits<double>::infinity();
+   double upperbound = std::numeric_limits<double>::infinity();
+   ArenaExpression* expr = nullptr;
+};
+
+// a Model with all its objects, names and term lists in one arena of large
+// blocks, so it is built with few allocations and freed by freeing the
+// blocks. it can be moved, which keeps the objects where they are, but not
+// copied.
+struct ArenaModel {
+   std::unique_ptr<ModelArena> arena;
+   ArenaExpression* objective = nullptr;
+   ObjectiveSense sense = ObjectiveSense::MIN;
+   ArenaVector<ArenaConstraint*> constraints;
+   ArenaVector<ArenaVariable*> variables;
+};
+
+#endif
@@ -1,23 +1,183 @@
 #ifndef __READERLP_BUILDER_HPP__
 #define __READERLP_BUILDER_HPP__
 
-#include <map>
-#include <memory>
+#include <limits>
 #include <string>
+#include <utility>
 
-#include "model.hpp"
+#include "compactmodel.hpp"
+#include "handler.hpp"
+#include "symboltable.hpp"
 
-struct Builder { 
-   std::map<std::string, std::shared_ptr<Variable>> variables; 
+struct Builder {
+   SymbolTable variables;
 
-   Model model;
+   // if set, the objective and constraints go to the handler instead of the model
+   ParseHandler* handler = nullptr;
 
-   std::shared_ptr<Variable> getvarbyname(std::string name) {
-      if (variables.count(name) == 0) {
-         variables[name] = std::shared_ptr<Variable>(new Variable(name));
-         model.variables.push_back(variables[name]);
+   CompactModel model;
+
+   // the expression currently being parsed
+   std::string exprname;
+   double exproffset = 0.0;
+   std::vector<uint32_t> exprindex;
+   std::vector<double> exprvalue;
+   QuadraticPart exprquad;
+
+   // terms of the objective hessian, merged once all columns are known
+   QuadraticPart objquad;
+
+   // make room for a model of about this size, in at most maxbytes. if it
+   // takes more, all counts are scaled down alike. rows go to the handler if
+   // there is one. names are not reserved, they take as much as the input.
+   void reserve(size_t nrows, size_t ncols, size_t nonzeros, size_t maxbytes) {
+      if (handler != nullptr) {
+         nrows = 0;
+         nonzeros = 0;
+      }
+      double bytes = (double)nrows * (3 * sizeof(double) + 2 * sizeof(size_t))
+         + (double)ncols * (2 * sizeof(double) + sizeof(VariableType) + SymbolTable::RESERVED_BYTES)
+         + (double)nonzeros * (sizeof(uint32_t) + sizeof(double));
+      if (bytes > maxbytes) {
+         double scale = maxbytes / bytes;
+         nrows = (size_t)(nrows * scale);
+         ncols = (size_t)(ncols * scale);
+         nonzeros = (size_t)(nonzeros * scale);
+      }
+
+      variables.reserve(ncols, 0);
+      model.collower.reserve(ncols);
+      model.colupper.reserve(ncols);
+      model.coltype.reserve(ncols);
+      if (handler != nullptr) {
+         return;
+      }
+      model.rowlower.reserve(nrows);
+      model.rowupper.reserve(nrows);
+      model.rowoffset.reserve(nrows);
+      model.rowstart.reserve(nrows + 1);
+      model.rownamestart.reserve(nrows + 1);
+      model.colindex.reserve(nonzeros);
+      model.value.reserve(nonzeros);
+   }
+
+   uint32_t getvarid(const char* name, size_t length) {
+      bool inserted;
+      uint32_t id = variables.intern(name, length, inserted);
+      if (inserted) {
+         model.collower.push_back(0.0);
+         model.colupper.push_back(std::numeric_limits<double>::infinity());
+         model.coltype.push_back(VariableType::CONTINUOUS);
+         if (handler != nullptr) {
+            handler->newvariable(id, name, length);
+         }
+      }
+      return id;
+   }
+
+   void addlinterm(uint32_t var, double coef) {
+      exprindex.push_back(var);
+      exprvalue.push_back(coef);
+   }
+
+   void addquadterm(uint32_t var1, uint32_t var2, double coef) {
+      exprquad.index1.push_back(var1);
+      exprquad.index2.push_back(var2);
+      exprquad.value.push_back(coef);
+   }
+
+   void clearexpression() {
+      exprname.clear();
+      exproffset = 0.0;
+      exprindex.clear();
+      exprvalue.clear();
+      exprquad.index1.clear();
+      exprquad.index2.clear();
+      exprquad.value.clear();
+   }
+
+   void setsense(ObjectiveSense sense) {
+      model.sense = sense;
+      if (handler != nullptr) {
+         handler->sense(sense);
+      }
+   }
+
+   void setbounds(uint32_t var, double lower, double upper) {
+      model.collower[var] = lower;
+      model.colupper[var] = upper;
+      if (handler != nullptr) {
+         handler->variablebound(var, lower, upper);
+      }
+   }
+
+   void settype(uint32_t var, VariableType type) {
+      model.coltype[var] = type;
+      if (handler != nullptr) {
+         handler->variabletype(var, type);
+      }
+   }
+
+   // moves the current expression into the objective
+   void setobjective() {
+      if (handler != nullptr) {
+         handler->objectivebegin(exprname.data(), exprname.size());
+         for (size_t k=0; k<exprindex.size(); k++) {
+            handler->objectiveterm(exprindex[k], exprvalue[k]);
+         }
+         for (size_t k=0; k<exprquad.size(); k++) {
+            handler->objectivequadterm(exprquad.index1[k], exprquad.index2[k], exprquad.value[k]);
+         }
+         handler->objectiveend(exproffset);
+         clearexpression();
+         return;
+      }
+      model.objname = exprname;
+      model.objoffset = exproffset;
+      model.objindex.swap(exprindex);
+      model.objvalue.swap(exprvalue);
+      std::swap(objquad, exprquad);
+      clearexpression();
+   }
+
+   // appends the current expression as constraint row
+   void addconstraint(double lowerbound, double upperbound) {
+      if (handler != nullptr) {
+         handler->constraintbegin(exprname.data(), exprname.size());
+         for (size_t k=0; k<exprindex.size(); k++) {
+            handler->constraintterm(exprindex[k], exprvalue[k]);
+         }
+         for (size_t k=0; k<exprquad.size(); k++) {
+            handler->constraintquadterm(exprquad.index1[k], exprquad.index2[k], exprquad.value[k]);
+         }
+         handler->constraintend(lowerbound, upperbound, exproffset);
+         clearexpression();
+         return;
+      }
+      model.rowlower.push_back(lowerbound);
+      model.rowupper.push_back(upperbound);
+      model.rowoffset.push_back(exproffset);
+      model.colindex.insert(model.colindex.end(), exprindex.begin(), exprindex.end());
+      model.value.insert(model.value.end(), exprvalue.begin(), exprvalue.end());
+      model.rowstart.push_back(model.value.size());
+      model.rownames.insert(model.rownames.end(), exprname.begin(), exprname.end());
+      model.rownamestart.push_back(model.rownames.size());
+      if (exprquad.size() > 0) {
+         model.quadrows.push_back(model.nrows() - 1);
+         model.rowhessians.push_back(createhessian(exprquad, 0));
+      }
+      clearexpression();
+   }
+
+   // hands the variable names over to the model and completes the objective
+   CompactModel& finish() {
+      if (handler != nullptr) {
+         handler->end();
+         return model;
       }
-      return variables[name];
+      variables.movenames(model.colnames, model.colnamestart);
+      model.objhessian = createhessian(objquad, model.ncols());
+      return model;
    }
 };
 
@@ -0,0 +1,264 @@
+#include "cache.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+#include <vector>
+
+#ifndef _WIN32
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <utime.h>
+#endif
+
+#include "mappedfile.hpp"
+#include "snapshot.hpp"
+
+const char LP_CACHE_SNAPSHOT_SUFFIX[] = ".snap";
+const char LP_CACHE_STAT_SUFFIX[] = ".stat";
+const char LP_CACHE_TEMP_SUFFIX[] = ".tmp";
+
+// temporary files of crashed writers are removed after this many seconds
+const long LP_CACHE_TEMP_LIFETIME = 3600;
+
+uint64_t mixbits(uint64_t h) {
+   h ^= h >> 30;
+   h *= 0xbf58476d1ce4e5b9ULL;
+   h ^= h >> 27;
+   h *= 0x94d049bb133111ebULL;
+   h ^= h >> 31;
+   return h;
+}
+
+// eight bytes per step, finished with the splitmix64 mixer
+uint64_t hashbytes(const char* data, size_t length, uint64_t seed) {
+   uint64_t h = mixbits(seed ^ (length * 0x9e3779b97f4a7c15ULL));
+   size_t i = 0;
+   for (; i + 8 <= length; i += 8) {
+      uint64_t word;
+      memcpy(&word, data + i, 8);
+      h = (h ^ mixbits(word)) * 0x9e3779b97f4a7c15ULL;
+      h = (h << 31) | (h >> 33);
+   }
+   if (i < length) {
+      uint64_t word = 0;
+      memcpy(&word, data + i, length - i);
+      h = (h ^ mixbits(word)) * 0x9e3779b97f4a7c15ULL;
+   }
+   return mixbits(h);
+}
+
+std::string hexstring(uint64_t value) {
+   char buffer[17];
+   snprintf(buffer, sizeof(buffer), "%016llx", (unsigned long long)value);
+   return std::string(buffer);
+}
+
+// whether key has the form of a content key, hash-length in hex digits,
+// so that it can be used in a path
+bool iscachekey(const std::string& key) {
+   if (key.size() != 33 || key[16] != '-') {
+      return false;
+   }
+   for (size_t i=0; i<key.size(); i++) {
+      if (i != 16 && !isxdigit((unsigned char)key[i])) {
+         return false;
+      }
+   }
+   return true;
+}
+
+bool endswith(const std::string& str, const char* suffix) {
+   size_t n = strlen(suffix);
+   return str.size() >= n && str.compare(str.size() - n, n, suffix) == 0;
+}
+
+ParseCache::ParseCache(std::string directory, uint64_t budget) : directory(directory), budget(budget) {
+#ifndef _WIN32
+   mkdir(directory.c_str(), 0777);
+#endif
+}
+
+#ifndef _WIN32
+// unique per process and call, so concurrent writers of an entry do not interfere
+std::string ParseCache::temppath(const std::string& name) const {
+   static std::atomic<unsigned long> counter(0);
+   return path(name + "." + std::to_string((long)getpid()) + "." + std::to_string(counter++) + LP_CACHE_TEMP_SUFFIX);
+}
+#endif
+
+// an entry that cannot be loaded, whatever the reason, is a miss. entries
+// only appear complete, so one that exists but does not load is damaged and
+// is removed.
+bool ParseCache::loadentry(const std::string& name, CompactModel& model) const {
+#ifndef _WIN32
+   struct stat st;
+   if (stat(path(name).c_str(), &st) != 0) {
+      return false;
+   }
+#endif
+   try {
+      model = readsnapshot(path(name));
+   } catch (...) {
+      remove(path(name).c_str());
+      return false;
+   }
+#ifndef _WIN32
+   // the modification time is the time of last use
+   utime(path(name).c_str(), nullptr);
+#endif
+   return true;
+}
+
+void ParseCache::writeentry(const std::string& name, const char* data, size_t length) const {
+#ifndef _WIN32
+   std::string temp = temppath(name);
+   FILE* file = fopen(temp.c_str(), "wb");
+   if (file == nullptr) {
+      return;
+   }
+   bool written = fwrite(data, 1, length, file) == length;
+   written = fclose(file) == 0 && written;
+   if (!written || rename(temp.c_str(), path(name).c_str()) != 0) {
+      remove(temp.c_str());
+   }
+#else
+   (void)name;
+   (void)data;
+   (void)length;
+#endif
+}
+
+bool ParseCache::lookup(const std::string& filename, CompactModel& model) {
+   key.clear();
+#ifndef _WIN32
+   struct stat st;
+   if (stat(filename.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+      return false;
+   }
+
+   // fast path: the key remembered for this very version of the file
+   uint64_t identity[6] = {(uint64_t)st.st_dev, (uint64_t)st.st_ino, (uint64_t)st.st_size, (uint64_t)st.st_mtime, 0, LP_CACHE_VERSION};
+#if defined(__APPLE__)
+   identity[4] = (uint64_t)st.st_mtimespec.tv_nsec;
+#else
+   identity[4] = (uint64_t)st.st_mtim.tv_nsec;
+#endif
+   std::string statname = hexstring(hashbytes((const char*)identity, sizeof(identity), 0)) + LP_CACHE_STAT_SUFFIX;
+
+   char buffer[64] = {};
+   FILE* file = fopen(path(statname).c_str(), "rb");
+   if (file != nullptr) {
+      size_t n = fread(buffer, 1, sizeof(buffer) - 1, file);
+      fclose(file);
+      key = std::string(buffer, n);
+      if (!iscachekey(key)) {
+         remove(path(statname).c_str());
+         key.clear();
+      }
+   }
+
+   if (key.empty()) {
+      MappedFile input(filename);
+      uint64_t seed = (uint64_t)LP_CACHE_VERSION << 32 | LP_SNAPSHOT_VERSION;
+      key = hexstring(hashbytes(input.begin(), input.length(), seed)) + "-" + hexstring((uint64_t)input.length());
+      writeentry(statname, key.data(), key.size());
+   } else {
+      utime(path(statname).c_str(), nullptr);
+   }
+   return loadentry(key + LP_CACHE_SNAPSHOT_SUFFIX, model);
+#else
+   (void)filename;
+   (void)model;
+   return false;
+#endif
+}
+
+void ParseCache::store(const CompactModel& model) {
+#ifndef _WIN32
+   if (key.empty()) {
+      return;
+   }
+   std::string name = key + LP_CACHE_SNAPSHOT_SUFFIX;
+   std::string temp = temppath(name);
+   try {
+      writesnapshot(temp, model);
+   } catch (const std::invalid_argument&) {
+      remove(temp.c_str());
+      return;
+   }
+   if (rename(temp.c_str(), path(name).c_str()) != 0) {
+      remove(temp.c_str());
+      return;
+   }
+   evict(name, budget);
+#else
+   (void)model;
+#endif
+}
+
+struct CacheEntry {
+   std::string name;
+   uint64_t size;
+   time_t lastuse;
+};
+
+void ParseCache::clear() {
+   key.clear();
+   evict("", 0);
+}
+
+// removes least recently used entries until the cache fits into limit bytes.
+// entries removed concurrently by other processes are simply skipped.
+void ParseCache::evict(const std::string& keep, uint64_t limit) const {
+#ifndef _WIN32
+   DIR* dir = opendir(directory.c_str());
+   if (dir == nullptr) {
+      return;
+   }
+
+   std::vector<CacheEntry> entries;
+   uint64_t total = 0;
+   time_t now = time(nullptr);
+   for (struct dirent* ent = readdir(dir); ent != nullptr; ent = readdir(dir)) {
+      std::string name = ent->d_name;
+      struct stat st;
+      if (stat(path(name).c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+         continue;
+      }
+      if (endswith(name, LP_CACHE_TEMP_SUFFIX)) {
+         if (now - st.st_mtime > LP_CACHE_TEMP_LIFETIME) {
+            remove(path(name).c_str());
+         }
+         continue;
+      }
+      if (!endswith(name, LP_CACHE_SNAPSHOT_SUFFIX) && !endswith(name, LP_CACHE_STAT_SUFFIX)) {
+         continue;
+      }
+      CacheEntry entry = {name, (uint64_t)st.st_size, st.st_mtime};
+      entries.push_back(entry);
+      total += entry.size;
+   }
+   closedir(dir);
+
+   std::sort(entries.begin(), entries.end(), [](const CacheEntry& a, const CacheEntry& b) {
+      return a.lastuse < b.lastuse || (a.lastuse == b.lastuse && a.name < b.name);
+   });
+   for (size_t i=0; i<entries.size() && total > limit; i++) {
+      if (entries[i].name == keep) {
+         continue;
+      }
+      remove(path(entries[i].name).c_str());
+      total -= entries[i].size;
+   }
+#else
+   (void)keep;
+   (void)limit;
+#endif
+}
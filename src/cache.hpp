@@ -0,0 +1,51 @@
+#ifndef __READERLP_CACHE_HPP__
+#define __READERLP_CACHE_HPP__
+
+#include <cstdint>
+#include <string>
+
+#include "compactmodel.hpp"
+
+// bump whenever the reader interprets files differently, so stale entries
+// are no longer found
+const uint32_t LP_CACHE_VERSION = 1;
+
+// 64 bit hash of a byte string
+uint64_t hashbytes(const char* data, size_t length, uint64_t seed);
+
+// directory of snapshots of parsed files, keyed by a hash of the file
+// contents. the key of a file is also remembered under its device, inode,
+// size and modification time, so that unchanged files need not be hashed
+// again. all files of the cache count as entries, and once they exceed the
+// budget the least recently used ones are removed.
+//
+// several processes may share a directory: entries are written to temporary
+// files and renamed into place, and readers keep mapped entries alive even
+// when another process removes them. any failure inside the cache turns
+// into a cache miss, and entries that do not load are removed.
+class ParseCache {
+private:
+   std::string directory;
+   uint64_t budget;
+   std::string key;   // content key of the file last looked up
+
+   std::string path(const std::string& name) const { return directory + "/" + name; }
+   std::string temppath(const std::string& name) const;
+   bool loadentry(const std::string& name, CompactModel& model) const;
+   void writeentry(const std::string& name, const char* data, size_t length) const;
+   void evict(const std::string& keep, uint64_t limit) const;
+
+public:
+   ParseCache(std::string directory, uint64_t budget);
+
+   // loads the cached model of filename, returns false on a miss
+   bool lookup(const std::string& filename, CompactModel& model);
+
+   // stores model as the entry of the file last looked up
+   void store(const CompactModel& model);
+
+   // removes all entries
+   void clear();
+};
+
+#endif
@@ -0,0 +1,376 @@
+#include "compactmodel.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <new>
+#include <unordered_map>
+#include <utility>
+
+#include "parallel.hpp"
+
+// below this many nonzeros per thread, threads cost more than they save
+const size_t LP_MIN_TRANSPOSE_NNZ_PER_THREAD = 1 << 16;
+
+void addlinterms(const Model& model, const uint32_t* index, const double* value, size_t n, std::shared_ptr<Expression> expr) {
+   expr->linterms.reserve(n);
+   for (size_t k=0; k<n; k++) {
+      std::shared_ptr<LinTerm> linterm = std::shared_ptr<LinTerm>(new LinTerm());
+      linterm->var = model.variables[index[k]];
+      linterm->coef = value[k];
+      expr->linterms.push_back(linterm);
+   }
+}
+
+// one term per entry of the lower triangle, x_i * x_j with i >= j
+void addquadterms(const Hessian& hessian, const Model& model, std::shared_ptr<Expression> expr) {
+   expr->quadterms.reserve(hessian.nnz());
+   for (uint32_t col=0; col<hessian.ncols(); col++) {
+      for (size_t k=hessian.start[col]; k<hessian.start[col+1]; k++) {
+         std::shared_ptr<QuadTerm> quadterm = std::shared_ptr<QuadTerm>(new QuadTerm());
+         quadterm->var1 = model.variables[col];
+         quadterm->var2 = model.variables[hessian.index[k]];
+         quadterm->coef = hessian.index[k] == col ? hessian.value[k] : 2.0 * hessian.value[k];
+         expr->quadterms.push_back(quadterm);
+      }
+   }
+}
+
+struct HessianEntry {
+   uint64_t key;   // column in the upper, row in the lower 32 bits
+   double value;
+};
+
+// least significant digit radix sort by key, one byte per pass. passes over
+// bytes that are the same in all keys are skipped, so small indices only
+// need a few passes.
+void sortentries(std::vector<HessianEntry>& entries) {
+   std::vector<HessianEntry> buffer(entries.size());
+   for (unsigned int shift=0; shift<64; shift+=8) {
+      size_t count[256] = {};
+      for (size_t k=0; k<entries.size(); k++) {
+         count[(entries[k].key >> shift) & 0xff]++;
+      }
+      if (count[(entries[0].key >> shift) & 0xff] == entries.size()) {
+         continue;
+      }
+
+      size_t position = 0;
+      for (unsigned int digit=0; digit<256; digit++) {
+         size_t n = count[digit];
+         count[digit] = position;
+         position += n;
+      }
+      for (size_t k=0; k<entries.size(); k++) {
+         buffer[count[(entries[k].key >> shift) & 0xff]++] = entries[k];
+      }
+      entries.swap(buffer);
+   }
+}
+
+Hessian createhessian(const QuadraticPart& quad, uint32_t ncols) {
+   Hessian hessian;
+   if (quad.size() == 0) {
+      hessian.start.assign(ncols + 1, 0);
+      return hessian;
+   }
+
+   // x_i * x_j with coefficient c is Q_ij = Q_ji = c/2, x_i^2 is Q_ii = c
+   std::vector<HessianEntry> entries(quad.size());
+   for (size_t k=0; k<quad.size(); k++) {
+      uint32_t row = std::max(quad.index1[k], quad.index2[k]);
+      uint32_t col = std::min(quad.index1[k], quad.index2[k]);
+      entries[k].key = (uint64_t)col << 32 | row;
+      entries[k].value = row == col ? quad.value[k] : 0.5 * quad.value[k];
+   }
+   sortentries(entries);
+
+   // sum up repeated entries
+   size_t n = 0;
+   for (size_t k=1; k<entries.size(); k++) {
+      if (entries[k].key == entries[n].key) {
+         entries[n].value += entries[k].value;
+      } else {
+         entries[++n] = entries[k];
+      }
+   }
+   entries.resize(n + 1);
+
+   uint32_t lastcol = (uint32_t)(entries.back().key >> 32);
+   hessian.start.assign(std::max(ncols, lastcol + 1) + 1, 0);
+   hessian.index.resize(entries.size());
+   hessian.value.resize(entries.size());
+   for (size_t k=0; k<entries.size(); k++) {
+      hessian.start[(entries[k].key >> 32) + 1]++;
+      hessian.index[k] = (uint32_t)entries[k].key;
+      hessian.value[k] = entries[k].value;
+   }
+   for (uint32_t col=0; col<hessian.ncols(); col++) {
+      hessian.start[col+1] += hessian.start[col];
+   }
+   return hessian;
+}
+
+Model createmodel(const CompactModel& compact) {
+   Model model;
+   model.sense = compact.sense;
+
+   model.variables.reserve(compact.ncols());
+   for (uint32_t col=0; col<compact.ncols(); col++) {
+      std::shared_ptr<Variable> var = std::shared_ptr<Variable>(new Variable(compact.colname(col)));
+      var->type = compact.coltype[col];
+      var->lowerbound = compact.collower[col];
+      var->upperbound = compact.colupper[col];
+      model.variables.push_back(var);
+   }
+
+   model.objective = std::shared_ptr<Expression>(new Expression);
+   model.objective->name = compact.objname;
+   model.objective->offset = compact.objoffset;
+   addlinterms(model, compact.objindex.data(), compact.objvalue.data(), compact.objindex.size(), model.objective);
+   addquadterms(compact.objhessian, model, model.objective);
+
+   model.constraints.reserve(compact.nrows());
+   size_t nextquad = 0;
+   for (uint32_t row=0; row<compact.nrows(); row++) {
+      std::shared_ptr<Constraint> con = std::shared_ptr<Constraint>(new Constraint);
+      con->lowerbound = compact.rowlower[row];
+      con->upperbound = compact.rowupper[row];
+      con->expr->name = compact.rowname(row);
+      con->expr->offset = compact.rowoffset[row];
+      size_t start = compact.rowstart[row];
+      addlinterms(model, compact.colindex.data() + start, compact.value.data() + start, compact.rowstart[row+1] - start, con->expr);
+      if (nextquad < compact.quadrows.size() && compact.quadrows[nextquad] == row) {
+         addquadterms(compact.rowhessians[nextquad], model, con->expr);
+         nextquad++;
+      }
+      model.constraints.push_back(con);
+   }
+
+   return model;
+}
+
+// a new object in the arena
+template <typename T, typename... Args>
+T* arenanew(ModelArena& arena, Args&&... args) {
+   return new (arena.allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+}
+
+void addlinterms(const ArenaModel& model, const uint32_t* index, const double* value, size_t n, ArenaExpression& expr) {
+   expr.linterms.resize(n);
+   for (size_t k=0; k<n; k++) {
+      expr.linterms[k].var = model.variables[index[k]];
+      expr.linterms[k].coef = value[k];
+   }
+}
+
+void addquadterms(const Hessian& hessian, const ArenaModel& model, ArenaExpression& expr) {
+   expr.quadterms.resize(hessian.nnz());
+   size_t n = 0;
+   for (uint32_t col=0; col<hessian.ncols(); col++) {
+      for (size_t k=hessian.start[col]; k<hessian.start[col+1]; k++) {
+         ArenaQuadTerm& quadterm = expr.quadterms[n++];
+         quadterm.var1 = model.variables[col];
+         quadterm.var2 = model.variables[hessian.index[k]];
+         quadterm.coef = hessian.index[k] == col ? hessian.value[k] : 2.0 * hessian.value[k];
+      }
+   }
+}
+
+ArenaModel createarenamodel(const CompactModel& compact, size_t blocksize) {
+   ArenaModel model;
+   model.arena.reset(new ModelArena(blocksize));
+   ModelArena& arena = *model.arena;
+   ArenaAllocator<char> allocator(&arena);
+   model.sense = compact.sense;
+
+   model.variables = ArenaVector<ArenaVariable*>(compact.ncols(), nullptr, allocator);
+   for (uint32_t col=0; col<compact.ncols(); col++) {
+      ArenaVariable* var = arenanew<ArenaVariable>(arena, allocator);
+      size_t start = compact.colnamestart[col];
+      var->name.assign(compact.colnames.data() + start, compact.colnamestart[col+1] - start);
+      var->type = compact.coltype[col];
+      var->lowerbound = compact.collower[col];
+      var->upperbound = compact.colupper[col];
+      model.variables[col] = var;
+   }
+
+   model.objective = arenanew<ArenaExpression>(arena, allocator);
+   model.objective->name.assign(compact.objname.data(), compact.objname.size());
+   model.objective->offset = compact.objoffset;
+   addlinterms(model, compact.objindex.data(), compact.objvalue.data(), compact.objindex.size(), *model.objective);
+   addquadterms(compact.objhessian, model, *model.objective);
+
+   model.constraints = ArenaVector<ArenaConstraint*>(compact.nrows(), nullptr, allocator);
+   size_t nextquad = 0;
+   for (uint32_t row=0; row<compact.nrows(); row++) {
+      ArenaConstraint* con = arenanew<ArenaConstraint>(arena);
+      con->lowerbound = compact.rowlower[row];
+      con->upperbound = compact.rowupper[row];
+      con->expr = arenanew<ArenaExpression>(arena, allocator);
+      size_t namestart = compact.rownamestart[row];
+      con->expr->name.assign(compact.rownames.data() + namestart, compact.rownamestart[row+1] - namestart);
+      con->expr->offset = compact.rowoffset[row];
+      size_t start = compact.rowstart[row];
+      addlinterms(model, compact.colindex.data() + start, compact.value.data() + start, compact.rowstart[row+1] - start, *con->expr);
+      if (nextquad < compact.quadrows.size() && compact.quadrows[nextquad] == row) {
+         addquadterms(compact.rowhessians[nextquad], model, *con->expr);
+         nextquad++;
+      }
+      model.constraints[row] = con;
+   }
+
+   return model;
+}
+
+uint32_t getcolumn(CompactModel& compact, std::unordered_map<const Variable*, uint32_t>& columns, const std::shared_ptr<Variable>& var) {
+   std::unordered_map<const Variable*, uint32_t>::iterator it = columns.find(var.get());
+   if (it != columns.end()) {
+      return it->second;
+   }
+   uint32_t col = compact.ncols();
+   columns[var.get()] = col;
+   compact.collower.push_back(var->lowerbound);
+   compact.colupper.push_back(var->upperbound);
+   compact.coltype.push_back(var->type);
+   compact.colnames.insert(compact.colnames.end(), var->name.begin(), var->name.end());
+   compact.colnamestart.push_back(compact.colnames.size());
+   return col;
+}
+
+void addquadraticpart(CompactModel& compact, std::unordered_map<const Variable*, uint32_t>& columns, const Expression& expr, QuadraticPart& quad) {
+   for (size_t k=0; k<expr.quadterms.size(); k++) {
+      quad.index1.push_back(getcolumn(compact, columns, expr.quadterms[k]->var1));
+      quad.index2.push_back(getcolumn(compact, columns, expr.quadterms[k]->var2));
+      quad.value.push_back(expr.quadterms[k]->coef);
+   }
+}
+
+CompactModel createcompactmodel(const Model& model) {
+   CompactModel compact;
+   compact.sense = model.sense;
+
+   std::unordered_map<const Variable*, uint32_t> columns;
+   for (size_t i=0; i<model.variables.size(); i++) {
+      getcolumn(compact, columns, model.variables[i]);
+   }
+
+   QuadraticPart objquad;
+   if (model.objective) {
+      compact.objname = model.objective->name;
+      compact.objoffset = model.objective->offset;
+      for (size_t k=0; k<model.objective->linterms.size(); k++) {
+         compact.objindex.push_back(getcolumn(compact, columns, model.objective->linterms[k]->var));
+         compact.objvalue.push_back(model.objective->linterms[k]->coef);
+      }
+      addquadraticpart(compact, columns, *model.objective, objquad);
+   }
+
+   for (size_t i=0; i<model.constraints.size(); i++) {
+      const Constraint& con = *model.constraints[i];
+      compact.rowlower.push_back(con.lowerbound);
+      compact.rowupper.push_back(con.upperbound);
+      compact.rowoffset.push_back(con.expr->offset);
+      for (size_t k=0; k<con.expr->linterms.size(); k++) {
+         compact.colindex.push_back(getcolumn(compact, columns, con.expr->linterms[k]->var));
+         compact.value.push_back(con.expr->linterms[k]->coef);
+      }
+      compact.rowstart.push_back(compact.value.size());
+      compact.rownames.insert(compact.rownames.end(), con.expr->name.begin(), con.expr->name.end());
+      compact.rownamestart.push_back(compact.rownames.size());
+      if (!con.expr->quadterms.empty()) {
+         QuadraticPart quad;
+         addquadraticpart(compact, columns, *con.expr, quad);
+         compact.quadrows.push_back((uint32_t)i);
+         compact.rowhessians.push_back(createhessian(quad, 0));
+      }
+   }
+
+   compact.objhessian = createhessian(objquad, compact.ncols());
+   return compact;
+}
+
+// counting sort transpose. the rows are split into one chunk per thread with
+// about the same number of nonzeros. each thread counts the entries per column
+// in its chunk, the counts are turned into per chunk write positions, and each
+// thread scatters its chunk. chunks are in row order and so are the rows
+// within a chunk, hence the columns come out sorted by row.
+ColumnMatrix createcolumnmatrix(const CompactModel& compact, unsigned int nthreads) {
+   const uint32_t ncols = compact.ncols();
+   const uint32_t nrows = compact.nrows();
+   const size_t nnz = compact.nnz();
+
+   ColumnMatrix matrix;
+   matrix.objective.assign(ncols, 0.0);
+   for (size_t k=0; k<compact.objindex.size(); k++) {
+      matrix.objective[compact.objindex[k]] += compact.objvalue[k];
+   }
+
+   // every chunk keeps one counter per column, keep those below nnz in total
+   size_t nchunks = getthreadcount(nthreads);
+   nchunks = std::min(nchunks, nnz / std::max((size_t)ncols, LP_MIN_TRANSPOSE_NNZ_PER_THREAD));
+   nchunks = std::max(nchunks, (size_t)1);
+
+   std::vector<uint32_t> chunkrow(nchunks + 1, nrows);
+   chunkrow[0] = 0;
+   for (size_t c=1; c<nchunks; c++) {
+      size_t target = nnz / nchunks * c;
+      chunkrow[c] = (uint32_t)(std::lower_bound(compact.rowstart.begin(), compact.rowstart.end() - 1, target) - compact.rowstart.begin());
+   }
+
+   std::vector<std::vector<size_t>> position(nchunks);
+   matrix.colstart.assign(ncols + 1, 0);
+   matrix.rowindex.resize(nnz);
+   matrix.value.resize(nnz);
+
+   runparallel(nchunks, [&](unsigned int c) {
+      std::vector<size_t>& count = position[c];
+      count.assign(ncols, 0);
+      for (size_t k=compact.rowstart[chunkrow[c]]; k<compact.rowstart[chunkrow[c+1]]; k++) {
+         count[compact.colindex[k]]++;
+      }
+   });
+
+   // the column ranges handled by each thread when combining the counts
+   std::vector<uint32_t> chunkcol(nchunks + 1);
+   for (size_t c=0; c<=nchunks; c++) {
+      chunkcol[c] = (uint32_t)((uint64_t)ncols * c / nchunks);
+   }
+
+   runparallel(nchunks, [&](unsigned int c) {
+      for (uint32_t col=chunkcol[c]; col<chunkcol[c+1]; col++) {
+         size_t count = 0;
+         for (size_t d=0; d<nchunks; d++) {
+            count += position[d][col];
+         }
+         matrix.colstart[col+1] = count;
+      }
+   });
+   for (uint32_t col=0; col<ncols; col++) {
+      matrix.colstart[col+1] += matrix.colstart[col];
+   }
+
+   // chunk d writes column col behind the entries of all earlier chunks
+   runparallel(nchunks, [&](unsigned int c) {
+      for (uint32_t col=chunkcol[c]; col<chunkcol[c+1]; col++) {
+         size_t next = matrix.colstart[col];
+         for (size_t d=0; d<nchunks; d++) {
+            size_t count = position[d][col];
+            position[d][col] = next;
+            next += count;
+         }
+      }
+   });
+
+   runparallel(nchunks, [&](unsigned int c) {
+      std::vector<size_t>& next = position[c];
+      for (uint32_t row=chunkrow[c]; row<chunkrow[c+1]; row++) {
+         for (size_t k=compact.rowstart[row]; k<compact.rowstart[row+1]; k++) {
+            size_t p = next[compact.colindex[k]]++;
+            matrix.rowindex[p] = row;
+            matrix.value[p] = compact.value[k];
+         }
+      }
+   });
+
+   return matrix;
+}
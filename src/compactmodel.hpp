@@ -0,0 +1,112 @@
+#ifndef __READERLP_COMPACTMODEL_HPP__
+#define __READERLP_COMPACTMODEL_HPP__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "arenamodel.hpp"
+#include "model.hpp"
+
+// quadratic part of an expression as read: the terms value[k] * index1[k] * index2[k]
+// inside [ ... ]/2, in any order and possibly repeated
+struct QuadraticPart {
+   std::vector<uint32_t> index1;
+   std::vector<uint32_t> index2;
+   std::vector<double> value;
+
+   size_t size() const { return value.size(); }
+};
+
+// symmetric matrix Q of a quadratic part 0.5 x'Qx, stored as its lower triangle
+// in compressed sparse column form. the entries of column j are
+// [start[j], start[j+1]) of index and value, sorted by row, with row >= j and
+// no row repeated. columns beyond start.size() - 1 are empty.
+struct Hessian {
+   std::vector<size_t> start = std::vector<size_t>(1, 0);
+   std::vector<uint32_t> index;
+   std::vector<double> value;
+
+   uint32_t ncols() const { return (uint32_t)start.size() - 1; }
+   size_t nnz() const { return value.size(); }
+};
+
+// index based structure-of-arrays form of a Model. variables (columns) and
+// constraints (rows) are numbered densely in order of appearance, the linear
+// part of the constraints is stored row-wise (compressed sparse row): the
+// nonzeros of row i are [rowstart[i], rowstart[i+1]) of colindex and value.
+// names are stored back to back, name i is [namestart[i], namestart[i+1]).
+struct CompactModel {
+   ObjectiveSense sense = ObjectiveSense::MIN;
+
+   // variables
+   std::vector<double> collower;
+   std::vector<double> colupper;
+   std::vector<VariableType> coltype;
+   std::vector<char> colnames;
+   std::vector<size_t> colnamestart = std::vector<size_t>(1, 0);
+
+   // objective
+   std::string objname;
+   double objoffset = 0.0;
+   std::vector<uint32_t> objindex;
+   std::vector<double> objvalue;
+   Hessian objhessian;
+
+   // constraints
+   std::vector<double> rowlower;
+   std::vector<double> rowupper;
+   std::vector<double> rowoffset;
+   std::vector<size_t> rowstart = std::vector<size_t>(1, 0);
+   std::vector<uint32_t> colindex;
+   std::vector<double> value;
+   std::vector<char> rownames;
+   std::vector<size_t> rownamestart = std::vector<size_t>(1, 0);
+
+   // quadratic parts of those rows that have one. the objective hessian
+   // covers all columns, those of the rows end at their last nonempty column.
+   std::vector<uint32_t> quadrows;
+   std::vector<Hessian> rowhessians;
+
+   uint32_t ncols() const { return (uint32_t)collower.size(); }
+   uint32_t nrows() const { return (uint32_t)rowlower.size(); }
+   size_t nnz() const { return value.size(); }
+
+   std::string colname(uint32_t col) const {
+      return std::string(colnames.data() + colnamestart[col], colnamestart[col+1] - colnamestart[col]);
+   }
+   std::string rowname(uint32_t row) const {
+      return std::string(rownames.data() + rownamestart[row], rownamestart[row+1] - rownamestart[row]);
+   }
+};
+
+// column-wise (compressed sparse column) copy of the constraint matrix and the
+// dense objective vector, as solvers expect them. the entries of column j are
+// [colstart[j], colstart[j+1]) of rowindex and value, ordered by row.
+struct ColumnMatrix {
+   std::vector<double> objective;
+   std::vector<size_t> colstart;
+   std::vector<uint32_t> rowindex;
+   std::vector<double> value;
+};
+
+// merges the terms of quad into a hessian with at least ncols columns, in time
+// linear in the number of terms and columns
+Hessian createhessian(const QuadraticPart& quad, uint32_t ncols);
+
+// builds the pointer based Model from its compact form
+Model createmodel(const CompactModel& compact);
+
+// the same in an arena of blocks of blocksize bytes. objects larger than a
+// block get one of their own.
+ArenaModel createarenamodel(const CompactModel& compact, size_t blocksize);
+
+// builds the compact form of a Model. variables not in model.variables are
+// added in order of appearance.
+CompactModel createcompactmodel(const Model& model);
+
+// transposes the constraint rows using up to nthreads threads, 0 meaning one
+// per core. the result does not depend on the number of threads.
+ColumnMatrix createcolumnmatrix(const CompactModel& compact, unsigned int nthreads = 0);
+
+#endif
@@ -0,0 +1,459 @@
+#include "compression.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <system_error>
+
+#ifdef READERLP_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef READERLP_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "def.hpp"
+
+// decompressed input is handed to the reader in steps of this size
+const size_t LP_DECOMPRESS_STEP = 1 << 18;
+
+// output is handed to the compressing thread in buffers of this size
+const size_t LP_COMPRESS_BUFFER_SIZE = 1 << 20;
+
+// zlib counts in unsigned int, larger inputs are fed in pieces
+const size_t LP_ZLIB_MAX_INPUT = 1 << 30;
+
+bool supportscompression(Compression compression) {
+   switch (compression) {
+      case Compression::NONE:
+         return true;
+      case Compression::GZIP:
+#ifdef READERLP_HAVE_ZLIB
+         return true;
+#else
+         return false;
+#endif
+      case Compression::ZSTD:
+#ifdef READERLP_HAVE_ZSTD
+         return true;
+#else
+         return false;
+#endif
+   }
+   return false;
+}
+
+Compression detectcompression(const char* data, size_t length) {
+   const unsigned char* bytes = (const unsigned char*)data;
+   if (length >= 2 && bytes[0] == 0x1f && bytes[1] == 0x8b) {
+      return Compression::GZIP;
+   }
+   if (length >= 4 && bytes[0] == 0x28 && bytes[1] == 0xb5 && bytes[2] == 0x2f && bytes[3] == 0xfd) {
+      return Compression::ZSTD;
+   }
+   return Compression::NONE;
+}
+
+class Decompressor {
+private:
+   Compression compression;
+   const char* input;
+   size_t length;
+   size_t consumed = 0;
+#ifdef READERLP_HAVE_ZLIB
+   z_stream gz;
+#endif
+#ifdef READERLP_HAVE_ZSTD
+   ZSTD_DStream* zs = nullptr;
+   ZSTD_inBuffer zin;
+#endif
+
+   size_t stepgzip(char* out, size_t capacity, bool& finished);
+   size_t stepzstd(char* out, size_t capacity, bool& finished);
+
+public:
+   Decompressor(const char* input, size_t length, Compression compression);
+   ~Decompressor();
+
+   // decompresses up to capacity bytes into out and returns their number.
+   // finished is set once all of the input is decompressed.
+   size_t step(char* out, size_t capacity, bool& finished) {
+      return compression == Compression::GZIP ? stepgzip(out, capacity, finished) : stepzstd(out, capacity, finished);
+   }
+};
+
+Decompressor::Decompressor(const char* input, size_t length, Compression compression) : compression(compression), input(input), length(length) {
+   lpassert(supportscompression(compression) && compression != Compression::NONE);
+#ifdef READERLP_HAVE_ZLIB
+   if (compression == Compression::GZIP) {
+      memset(&gz, 0, sizeof(gz));
+      // 32 detects the gzip header
+      lpassert(inflateInit2(&gz, 15 + 32) == Z_OK);
+   }
+#endif
+#ifdef READERLP_HAVE_ZSTD
+   if (compression == Compression::ZSTD) {
+      zs = ZSTD_createDStream();
+      lpassert(zs != nullptr);
+      ZSTD_initDStream(zs);
+      zin.src = input;
+      zin.size = length;
+      zin.pos = 0;
+   }
+#endif
+}
+
+Decompressor::~Decompressor() {
+#ifdef READERLP_HAVE_ZLIB
+   if (compression == Compression::GZIP) {
+      inflateEnd(&gz);
+   }
+#endif
+#ifdef READERLP_HAVE_ZSTD
+   if (zs != nullptr) {
+      ZSTD_freeDStream(zs);
+   }
+#endif
+}
+
+size_t Decompressor::stepgzip(char* out, size_t capacity, bool& finished) {
+#ifdef READERLP_HAVE_ZLIB
+   gz.next_out = (Bytef*)out;
+   gz.avail_out = (uInt)std::min(capacity, (size_t)UINT_MAX);
+   while (gz.avail_out > 0) {
+      if (gz.avail_in == 0 && consumed < length) {
+         gz.next_in = (Bytef*)(input + consumed);
+         gz.avail_in = (uInt)std::min(length - consumed, LP_ZLIB_MAX_INPUT);
+         consumed += gz.avail_in;
+      }
+      int ret = inflate(&gz, Z_NO_FLUSH);
+      if (ret == Z_STREAM_END) {
+         // files may consist of several gzip members
+         if (gz.avail_in == 0 && consumed == length) {
+            finished = true;
+            break;
+         }
+         lpassert(inflateReset(&gz) == Z_OK);
+         continue;
+      }
+      // input that ends early leaves no progress to make
+      lpassert(ret == Z_OK);
+   }
+   return (char*)gz.next_out - out;
+#else
+   (void)out;
+   (void)capacity;
+   (void)finished;
+   lpassert(false);
+   return 0;
+#endif
+}
+
+size_t Decompressor::stepzstd(char* out, size_t capacity, bool& finished) {
+#ifdef READERLP_HAVE_ZSTD
+   ZSTD_outBuffer zout = {out, capacity, 0};
+   while (zout.pos < zout.size) {
+      size_t ret = ZSTD_decompressStream(zs, &zout, &zin);
+      lpassert(!ZSTD_isError(ret));
+      if (zin.pos == zin.size) {
+         // 0 once the last frame is complete and flushed
+         if (ret == 0) {
+            finished = true;
+            break;
+         }
+         // with room left in the output, everything was flushed, so input is missing
+         lpassert(zout.pos == zout.size);
+      }
+   }
+   return zout.pos;
+#else
+   (void)out;
+   (void)capacity;
+   (void)finished;
+   lpassert(false);
+   return 0;
+#endif
+}
+
+DecompressedInput::DecompressedInput(const char* input, size_t length, Compression compression) {
+   decompressor = new Decompressor(input, length, compression);
+
+   if (reserve(LP_STREAM_RESERVATION)) {
+      try {
+         thread = std::thread([this]() { decompress(); });
+         return;
+      } catch (const std::system_error&) {
+         // out of threads, decompressed below
+      }
+   }
+
+   // without the address space, all input is decompressed up front
+   try {
+      bool done = false;
+      size_t produced = 0;
+      while (!done) {
+         if (reserved) {
+            lpassert(produced < capacity || makeroom(produced, produced + LP_DECOMPRESS_STEP));
+            produced += decompressor->step(data + produced, std::min(LP_DECOMPRESS_STEP, capacity - produced), done);
+         } else {
+            buffer.resize(produced + LP_DECOMPRESS_STEP);
+            produced += decompressor->step(buffer.data() + produced, LP_DECOMPRESS_STEP, done);
+         }
+      }
+      if (!reserved) {
+         buffer.resize(produced);
+         data = buffer.data();
+      }
+      available = produced;
+   } catch (...) {
+      delete decompressor;
+      throw;
+   }
+   finished = true;
+}
+
+DecompressedInput::~DecompressedInput() {
+   if (thread.joinable()) {
+      cancel();
+      thread.join();
+   }
+   delete decompressor;
+}
+
+void DecompressedInput::decompress() {
+   try {
+      size_t produced = 0;
+      bool done = false;
+      while (!done) {
+         if (produced == capacity && !makeroom(produced, produced + LP_DECOMPRESS_STEP)) {
+            return;
+         }
+         size_t before = produced;
+         produced += decompressor->step(data + produced, std::min(LP_DECOMPRESS_STEP, capacity - produced), done);
+
+         // only whole lines are handed out
+         size_t end = done ? produced : lastlineend(data, before, produced);
+         if ((end > before || done) && !publish(end, done)) {
+            return;
+         }
+      }
+   } catch (...) {
+      fail();
+   }
+}
+
+class Compressor {
+private:
+   Compression compression;
+   FILE* file;
+   std::vector<char> out;
+#ifdef READERLP_HAVE_ZLIB
+   z_stream gz;
+#endif
+#ifdef READERLP_HAVE_ZSTD
+   ZSTD_CStream* zs = nullptr;
+#endif
+
+   void writeout(size_t length) {
+      lpassert(fwrite(out.data(), 1, length, file) == length);
+   }
+
+   void deflateall(const char* data, size_t length, int finish);
+   void zstdall(const char* data, size_t length, bool end);
+
+public:
+   Compressor(Compression compression, FILE* file);
+   ~Compressor();
+
+   void compress(const char* data, size_t length) {
+      if (compression == Compression::GZIP) {
+         deflateall(data, length, 0);
+      } else {
+         zstdall(data, length, false);
+      }
+   }
+
+   // ends the stream
+   void finish() {
+      if (compression == Compression::GZIP) {
+         deflateall(nullptr, 0, 1);
+      } else {
+         zstdall(nullptr, 0, true);
+      }
+   }
+};
+
+Compressor::Compressor(Compression compression, FILE* file) : compression(compression), file(file), out(1 << 18) {
+   lpassert(supportscompression(compression) && compression != Compression::NONE);
+#ifdef READERLP_HAVE_ZLIB
+   if (compression == Compression::GZIP) {
+      memset(&gz, 0, sizeof(gz));
+      // 16 writes a gzip header
+      lpassert(deflateInit2(&gz, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+   }
+#endif
+#ifdef READERLP_HAVE_ZSTD
+   if (compression == Compression::ZSTD) {
+      zs = ZSTD_createCStream();
+      lpassert(zs != nullptr);
+      if (ZSTD_isError(ZSTD_initCStream(zs, ZSTD_CLEVEL_DEFAULT))) {
+         ZSTD_freeCStream(zs);
+         lpassert(false);
+      }
+   }
+#endif
+}
+
+Compressor::~Compressor() {
+#ifdef READERLP_HAVE_ZLIB
+   if (compression == Compression::GZIP) {
+      deflateEnd(&gz);
+   }
+#endif
+#ifdef READERLP_HAVE_ZSTD
+   if (zs != nullptr) {
+      ZSTD_freeCStream(zs);
+   }
+#endif
+}
+
+void Compressor::deflateall(const char* data, size_t length, int finish) {
+#ifdef READERLP_HAVE_ZLIB
+   size_t consumed = 0;
+   do {
+      gz.next_in = (Bytef*)(data + consumed);
+      gz.avail_in = (uInt)std::min(length - consumed, LP_ZLIB_MAX_INPUT);
+      consumed += gz.avail_in;
+      int flush = finish && consumed == length ? Z_FINISH : Z_NO_FLUSH;
+      int ret;
+      do {
+         gz.next_out = (Bytef*)out.data();
+         gz.avail_out = (uInt)out.size();
+         ret = deflate(&gz, flush);
+         lpassert(ret != Z_STREAM_ERROR);
+         writeout(out.size() - gz.avail_out);
+      } while (gz.avail_out == 0 || (flush == Z_FINISH && ret != Z_STREAM_END));
+   } while (consumed < length);
+#else
+   (void)data;
+   (void)length;
+   (void)finish;
+   lpassert(false);
+#endif
+}
+
+void Compressor::zstdall(const char* data, size_t length, bool end) {
+#ifdef READERLP_HAVE_ZSTD
+   ZSTD_inBuffer zin = {data, length, 0};
+   size_t remaining;
+   do {
+      ZSTD_outBuffer zout = {out.data(), out.size(), 0};
+      remaining = ZSTD_compressStream2(zs, &zout, &zin, end ? ZSTD_e_end : ZSTD_e_continue);
+      lpassert(!ZSTD_isError(remaining));
+      writeout(zout.pos);
+   } while (zin.pos < zin.size || (end && remaining > 0));
+#else
+   (void)data;
+   (void)length;
+   (void)end;
+   lpassert(false);
+#endif
+}
+
+OutputFile::OutputFile(std::string filename, Compression compression) : file(fopen(filename.c_str(), compression == Compression::NONE ? "w" : "wb")) {
+   lpassert(file != nullptr);
+   if (compression == Compression::NONE) {
+      // the callers buffer their output
+      setvbuf(file, nullptr, _IONBF, 0);
+      return;
+   }
+   // the destructor does not run if this throws
+   try {
+      compressor = new Compressor(compression, file);
+      pending.reserve(LP_COMPRESS_BUFFER_SIZE);
+      thread = std::thread([this]() { compress(); });
+   } catch (...) {
+      delete compressor;
+      fclose(file);
+      throw;
+   }
+}
+
+OutputFile::~OutputFile() {
+   if (thread.joinable()) {
+      {
+         std::lock_guard<std::mutex> lock(mutex);
+         closing = true;
+         changed.notify_all();
+      }
+      thread.join();
+   }
+   delete compressor;
+   if (file != nullptr) {
+      fclose(file);
+   }
+}
+
+void OutputFile::compress() {
+   std::unique_lock<std::mutex> lock(mutex);
+   while (true) {
+      changed.wait(lock, [&]() { return busy || closing; });
+      if (!busy) {
+         break;
+      }
+      lock.unlock();
+      bool ok = true;
+      try {
+         compressor->compress(handed.data(), handed.size());
+      } catch (...) {
+         ok = false;
+      }
+      lock.lock();
+      failed = failed || !ok;
+      busy = false;
+      changed.notify_all();
+   }
+}
+
+// waits for the thread to finish the previous buffer and gives it the pending one
+void OutputFile::handover() {
+   std::unique_lock<std::mutex> lock(mutex);
+   changed.wait(lock, [&]() { return !busy; });
+   lpassert(!failed);
+   pending.swap(handed);
+   pending.clear();
+   busy = true;
+   changed.notify_all();
+}
+
+void OutputFile::write(const char* data, size_t length) {
+   if (compressor == nullptr) {
+      lpassert(fwrite(data, 1, length, file) == length);
+      return;
+   }
+   pending.insert(pending.end(), data, data + length);
+   if (pending.size() >= LP_COMPRESS_BUFFER_SIZE) {
+      handover();
+   }
+}
+
+void OutputFile::close() {
+   if (compressor != nullptr) {
+      if (!pending.empty()) {
+         handover();
+      }
+      {
+         std::lock_guard<std::mutex> lock(mutex);
+         closing = true;
+         changed.notify_all();
+      }
+      thread.join();
+      lpassert(!failed);
+      compressor->finish();
+   }
+   FILE* closed = file;
+   file = nullptr;
+   lpassert(fclose(closed) == 0);
+}
@@ -0,0 +1,75 @@
+#ifndef __READERLP_COMPRESSION_HPP__
+#define __READERLP_COMPRESSION_HPP__
+
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "streaminput.hpp"
+
+enum class Compression {
+   NONE,
+   GZIP,
+   ZSTD
+};
+
+// whether the library was built with support for the compression
+bool supportscompression(Compression compression);
+
+// the compression of data, as told by at most the first LP_MAX_MAGIC_LENGTH bytes
+const size_t LP_MAX_MAGIC_LENGTH = 4;
+Compression detectcompression(const char* data, size_t length);
+
+class Decompressor;
+
+// compressed input, decompressed on a second thread while it is parsed
+class DecompressedInput : public StreamInput {
+private:
+   std::thread thread;
+   Decompressor* decompressor = nullptr;
+
+   void decompress();
+
+public:
+   DecompressedInput(const char* input, size_t length, Compression compression);
+   ~DecompressedInput();
+};
+
+class Compressor;
+
+// output file, compressed on a second thread while the caller goes on
+// producing output. without compression it is written through directly.
+class OutputFile {
+private:
+   FILE* file;
+   Compressor* compressor = nullptr;
+
+   std::vector<char> pending;   // filled by the caller
+   std::vector<char> handed;    // being compressed
+   std::mutex mutex;
+   std::condition_variable changed;
+   bool busy = false;
+   bool closing = false;
+   bool failed = false;
+   std::thread thread;
+
+   void compress();
+   void handover();
+
+   OutputFile(const OutputFile&);
+   OutputFile& operator=(const OutputFile&);
+
+public:
+   OutputFile(std::string filename, Compression compression);
+   ~OutputFile();
+
+   void write(const char* data, size_t length);
+
+   // writes what is left and closes the file
+   void close();
+};
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef __READERLP_HANDLER_HPP__
+#define __READERLP_HANDLER_HPP__
+
+#include <cstddef>
+#include <cstdint>
+
+#include "model.hpp"
+
+// receives the contents of an instance in the order the reader finds them,
+// without a model being built. variables are numbered in order of first
+// appearance and announced by newvariable before they are used. names are
+// not null-terminated and only valid during the call.
+//
+// quadratic coefficients are the ones written inside [ ... ]/2, so a term
+// contributes coef/2 * var1 * var2. the reader keeps the bounds and types of
+// the variables, but nothing per constraint.
+class ParseHandler {
+public:
+   virtual ~ParseHandler() {}
+
+   virtual void sense(ObjectiveSense sense) { (void)sense; }
+   virtual void newvariable(uint32_t var, const char* name, size_t length) { (void)var; (void)name; (void)length; }
+
+   virtual void objectivebegin(const char* name, size_t length) { (void)name; (void)length; }
+   virtual void objectiveterm(uint32_t var, double coef) { (void)var; (void)coef; }
+   virtual void objectivequadterm(uint32_t var1, uint32_t var2, double coef) { (void)var1; (void)var2; (void)coef; }
+   virtual void objectiveend(double offset) { (void)offset; }
+
+   virtual void constraintbegin(const char* name, size_t length) { (void)name; (void)length; }
+   virtual void constraintterm(uint32_t var, double coef) { (void)var; (void)coef; }
+   virtual void constraintquadterm(uint32_t var1, uint32_t var2, double coef) { (void)var1; (void)var2; (void)coef; }
+   // lower <= expression + offset <= upper
+   virtual void constraintend(double lower, double upper, double offset) { (void)lower; (void)upper; (void)offset; }
+
+   // the bounds of var after a statement of the bounds section
+   virtual void variablebound(uint32_t var, double lower, double upper) { (void)var; (void)lower; (void)upper; }
+   virtual void variabletype(uint32_t var, VariableType type) { (void)var; (void)type; }
+
+   // the instance is complete
+   virtual void end() {}
+};
+
+#endif
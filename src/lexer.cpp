@@ -0,0 +1,310 @@
+#include "lexer.hpp"
+
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+
+#include "def.hpp"
+
+// \0 \t \n \r space + - / : < = > [ \ ] ^
+const bool LP_IDENTIFIER_DELIMITER[256] = {
+   1,0,0,0,0,0,0,0,0,1,1,0,0,1,0,0,
+   0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+   1,0,0,0,0,0,0,0,0,0,0,1,0,1,0,1,
+   0,0,0,0,0,0,0,0,0,0,1,0,1,1,1,0,
+   0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+   0,0,0,0,0,0,0,0,0,0,0,1,1,1,1,0,
+   0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+   0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+   0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+   0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+   0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+   0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+   0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+   0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+   0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+   0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0
+};
+
+// all powers of ten that are exactly representable as double
+const double LP_EXACT_POWERS_OF_TEN[] = {
+   1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+   1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+const int LP_MAX_EXACT_POWER_OF_TEN = 22;
+const int LP_MAX_MANTISSA_DIGITS = 19;
+const uint64_t LP_MAX_EXACT_MANTISSA = (uint64_t)1 << 53;
+const int LP_MAX_HEX_MANTISSA_DIGITS = 15;
+
+inline bool isdecimaldigit(char c) {
+   return (unsigned char)(c - '0') < 10;
+}
+
+// hands a null-terminated copy of [pos, end) to strtod
+const char* lexnumberstrtod(const char* pos, const char* end, double& value) {
+   std::string number(pos, end);
+   char* endptr;
+   value = strtod(number.c_str(), &endptr);
+   return pos + (endptr - number.c_str());
+}
+
+// value of the hexadecimal digit c, -1 if it is none
+inline int hexdigitvalue(char c) {
+   if (isdecimaldigit(c)) {
+      return c - '0';
+   }
+   if (c >= 'a' && c <= 'f') {
+      return c - 'a' + 10;
+   }
+   if (c >= 'A' && c <= 'F') {
+      return c - 'A' + 10;
+   }
+   return -1;
+}
+
+// reads a hexadecimal float like 0x1.8p+1 starting at pos, which holds "0x"
+const char* lexhexnumber(const char* pos, const char* end, double& value) {
+   const char* p = pos + 2;
+   uint64_t mantissa = 0;
+   int ndigits = 0;
+   int exponent = 0;
+   bool anydigits = false;
+   bool truncated = false;
+
+   // integer part, then fractional part
+   for (int part=0; part<2; part++) {
+      for (int digit; p < end && (digit = hexdigitvalue(*p)) >= 0; p++) {
+         anydigits = true;
+         if (ndigits < LP_MAX_HEX_MANTISSA_DIGITS) {
+            mantissa = mantissa * 16 + digit;
+            ndigits += mantissa != 0;
+            exponent -= 4 * part;
+         } else {
+            truncated = true;
+         }
+      }
+      if (part == 1 || p == end || *p != '.') {
+         break;
+      }
+      p++;
+   }
+
+   // like strtod, "0x" without digits is the number 0
+   if (!anydigits) {
+      value = 0.0;
+      return pos + 1;
+   }
+
+   // binary exponent, only consumed if at least one digit follows
+   if (p < end && (*p == 'p' || *p == 'P')) {
+      const char* q = p + 1;
+      bool negative = false;
+      if (q < end && (*q == '+' || *q == '-')) {
+         negative = *q == '-';
+         q++;
+      }
+      if (q < end && isdecimaldigit(*q)) {
+         int e = 0;
+         for (; q < end && isdecimaldigit(*q); q++) {
+            if (e < 100000) {
+               e = e * 10 + (*q - '0');
+            }
+         }
+         exponent += negative ? -e : e;
+         p = q;
+      }
+   }
+
+   // the mantissa is exact, so scaling it by a power of two rounds only once
+   if (!truncated && mantissa <= LP_MAX_EXACT_MANTISSA) {
+      value = ldexp((double)mantissa, exponent);
+      return p;
+   }
+   return lexnumberstrtod(pos, p, value);
+}
+
+const char* lexnumber(const char* pos, const char* end, double& value) {
+   const char* p = pos;
+
+   if (end - p >= 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+      return lexhexnumber(pos, end, value);
+   }
+
+   uint64_t mantissa = 0;
+   int ndigits = 0;
+   int exponent = 0;
+   bool anydigits = false;
+   bool truncated = false;
+
+   // integer part
+   for (; p < end && isdecimaldigit(*p); p++) {
+      anydigits = true;
+      if (ndigits < LP_MAX_MANTISSA_DIGITS) {
+         mantissa = mantissa * 10 + (*p - '0');
+         ndigits += mantissa != 0;
+      } else {
+         truncated = true;
+      }
+   }
+
+   // fractional part
+   if (p < end && *p == '.') {
+      for (p++; p < end && isdecimaldigit(*p); p++) {
+         anydigits = true;
+         if (ndigits < LP_MAX_MANTISSA_DIGITS) {
+            mantissa = mantissa * 10 + (*p - '0');
+            ndigits += mantissa != 0;
+            exponent--;
+         } else {
+            truncated = true;
+         }
+      }
+   }
+
+   if (!anydigits) {
+      return pos;
+   }
+
+   // exponent, only consumed if at least one digit follows
+   if (p < end && (*p == 'e' || *p == 'E')) {
+      const char* q = p + 1;
+      bool negative = false;
+      if (q < end && (*q == '+' || *q == '-')) {
+         negative = *q == '-';
+         q++;
+      }
+      if (q < end && isdecimaldigit(*q)) {
+         int e = 0;
+         for (; q < end && isdecimaldigit(*q); q++) {
+            if (e < 100000) {
+               e = e * 10 + (*q - '0');
+            }
+         }
+         exponent += negative ? -e : e;
+         p = q;
+      }
+   }
+
+   if (!truncated && mantissa == 0) {
+      value = 0.0;
+      return p;
+   }
+
+   // Clinger's fast path: mantissa and power of ten are both exact, so the
+   // single multiplication or division rounds correctly. this requires
+   // arithmetic to be carried out in double precision (no x87 extended)
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+   if (!truncated && mantissa <= LP_MAX_EXACT_MANTISSA
+   && exponent >= -LP_MAX_EXACT_POWER_OF_TEN && exponent <= LP_MAX_EXACT_POWER_OF_TEN) {
+      double m = (double)mantissa;
+      value = exponent < 0 ? m / LP_EXACT_POWERS_OF_TEN[-exponent] : m * LP_EXACT_POWERS_OF_TEN[exponent];
+      return p;
+   }
+#endif
+
+   return lexnumberstrtod(pos, p, value);
+}
+
+// longest spelling of any keyword
+const size_t LP_MAX_KEYWORD_LENGTH = 15;
+
+// spellings of the same length and first character
+const unsigned int LP_KEYWORD_SLOT_SIZE = 2;
+
+inline char lowercase(char c) {
+   return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+}
+
+struct KeywordSpelling {
+   const std::string* spelling = nullptr;
+   LpKeyword keyword = LpKeyword::NONE;
+};
+
+// the spellings of the keywords in def.hpp, by length and the low five bits
+// of their first character, which are the same for both cases of a letter
+class KeywordTable {
+private:
+   KeywordSpelling slots[LP_MAX_KEYWORD_LENGTH + 1][32][LP_KEYWORD_SLOT_SIZE];
+
+   void add(const std::string* spellings, unsigned int n, LpKeyword keyword) {
+      for (unsigned int i=0; i<n; i++) {
+         lpassert(spellings[i].size() <= LP_MAX_KEYWORD_LENGTH);
+         KeywordSpelling* slot = this->slot(spellings[i].size(), spellings[i][0]);
+         unsigned int k = 0;
+         while (slot[k].spelling != nullptr) {
+            k++;
+            lpassert(k < LP_KEYWORD_SLOT_SIZE);
+         }
+         slot[k].spelling = &spellings[i];
+         slot[k].keyword = keyword;
+      }
+   }
+
+   KeywordSpelling* slot(size_t length, char first) {
+      return slots[length][first & 31];
+   }
+
+public:
+   KeywordTable() {
+      add(LP_KEYWORD_MIN, LP_KEYWORD_MIN_N, LpKeyword::MIN);
+      add(LP_KEYWORD_MAX, LP_KEYWORD_MAX_N, LpKeyword::MAX);
+      add(LP_KEYWORD_ST, LP_KEYWORD_ST_N, LpKeyword::ST);
+      add(LP_KEYWORD_BOUNDS, LP_KEYWORD_BOUNDS_N, LpKeyword::BOUNDS);
+      add(LP_KEYWORD_INF, LP_KEYWORD_INF_N, LpKeyword::INF);
+      add(LP_KEYWORD_FREE, LP_KEYWORD_FREE_N, LpKeyword::FREE);
+      add(LP_KEYWORD_GEN, LP_KEYWORD_GEN_N, LpKeyword::GEN);
+      add(LP_KEYWORD_BIN, LP_KEYWORD_BIN_N, LpKeyword::BIN);
+      add(LP_KEYWORD_SEMI, LP_KEYWORD_SEMI_N, LpKeyword::SEMI);
+      add(LP_KEYWORD_SOS, LP_KEYWORD_SOS_N, LpKeyword::SOS);
+      add(LP_KEYWORD_END, LP_KEYWORD_END_N, LpKeyword::END);
+   }
+
+   // the spellings that may match a name of the length, empty ones at the end
+   const KeywordSpelling* candidates(size_t length, char first) const {
+      return length <= LP_MAX_KEYWORD_LENGTH ? slots[length][first & 31] : nullptr;
+   }
+};
+
+const KeywordTable LP_KEYWORD_TABLE;
+
+// whether [name, name + length) equals spelling from offset on, ignoring case
+inline bool matchesnocase(const std::string& spelling, size_t offset, const char* name, size_t length) {
+   for (size_t i=0; i<length; i++) {
+      if (lowercase(name[i]) != spelling[offset + i]) {
+         return false;
+      }
+   }
+   return true;
+}
+
+LpKeyword lexkeyword(const char* name, size_t length) {
+   if (length == 0) {
+      return LpKeyword::NONE;
+   }
+   const KeywordSpelling* candidates = LP_KEYWORD_TABLE.candidates(length, name[0]);
+   for (unsigned int k=0; candidates != nullptr && k<LP_KEYWORD_SLOT_SIZE && candidates[k].spelling != nullptr; k++) {
+      if (matchesnocase(*candidates[k].spelling, 0, name, length)) {
+         return candidates[k].keyword;
+      }
+   }
+   return LpKeyword::NONE;
+}
+
+LpKeyword lexkeyword(const char* first, size_t firstlength, char separator, const char* second, size_t secondlength) {
+   if (firstlength == 0) {
+      return LpKeyword::NONE;
+   }
+   const KeywordSpelling* candidates = LP_KEYWORD_TABLE.candidates(firstlength + 1 + secondlength, first[0]);
+   for (unsigned int k=0; candidates != nullptr && k<LP_KEYWORD_SLOT_SIZE && candidates[k].spelling != nullptr; k++) {
+      const std::string& spelling = *candidates[k].spelling;
+      if (spelling[firstlength] == separator
+      && matchesnocase(spelling, 0, first, firstlength)
+      && matchesnocase(spelling, firstlength + 1, second, secondlength)) {
+         return candidates[k].keyword;
+      }
+   }
+   return LpKeyword::NONE;
+}
@@ -0,0 +1,35 @@
+#ifndef __READERLP_LEXER_HPP__
+#define __READERLP_LEXER_HPP__
+
+#include <cstddef>
+
+// true for all characters that terminate an identifier
+extern const bool LP_IDENTIFIER_DELIMITER[256];
+
+inline bool isidentifierdelimiter(char c) {
+   return LP_IDENTIFIER_DELIMITER[(unsigned char)c];
+}
+
+// returns the end of the identifier starting at pos
+inline const char* lexidentifier(const char* pos, const char* end) {
+   while (pos < end && !isidentifierdelimiter(*pos)) {
+      pos++;
+   }
+   return pos;
+}
+
+// reads the unsigned number starting at pos, correctly rounded exactly like
+// strtod. returns the end of the number, or pos if there is no number
+const char* lexnumber(const char* pos, const char* end, double& value);
+
+enum class LpKeyword { NONE, MIN, MAX, ST, BOUNDS, INF, FREE, GEN, BIN, SEMI, SOS, END };
+
+// the keyword the identifier [name, name + length) spells, ignoring case.
+// most names are rejected by their length or first character alone.
+LpKeyword lexkeyword(const char* name, size_t length);
+
+// the keyword two identifiers joined by separator spell, like "subject to"
+// or "semi-continuous"
+LpKeyword lexkeyword(const char* first, size_t firstlength, char separator, const char* second, size_t secondlength);
+
+#endif
@@ -0,0 +1,76 @@
+#include "mappedfile.hpp"
+
+#include <cstdio>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "def.hpp"
+
+MappedFile::MappedFile(std::string filename) : data(nullptr), size(0), mapped(false) {
+   if (!map(filename)) {
+      read(filename);
+   }
+}
+
+MappedFile::~MappedFile() {
+#ifndef _WIN32
+   if (mapped) {
+      munmap((void*)data, size);
+   }
+#endif
+}
+
+bool MappedFile::map(const std::string& filename) {
+#ifndef _WIN32
+   int fd = open(filename.c_str(), O_RDONLY);
+   lpassert(fd >= 0);
+
+   struct stat st;
+   if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0) {
+      close(fd);
+      return false;
+   }
+
+   void* addr = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   close(fd);
+   if (addr == MAP_FAILED) {
+      return false;
+   }
+
+   // the tokenizer makes a single front-to-back pass over the file
+   madvise(addr, (size_t)st.st_size, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+   madvise(addr, (size_t)st.st_size, MADV_HUGEPAGE);
+#endif
+
+   data = (const char*)addr;
+   size = (size_t)st.st_size;
+   mapped = true;
+   return true;
+#else
+   (void)filename;
+   return false;
+#endif
+}
+
+void MappedFile::read(const std::string& filename) {
+   FILE* file = fopen(filename.c_str(), "rb");
+   lpassert(file != nullptr);
+
+   const size_t chunk = 1 << 16;
+   size_t nread;
+   do {
+      buffer.resize(size + chunk);
+      nread = fread(buffer.data() + size, 1, chunk, file);
+      size += nread;
+   } while (nread == chunk);
+   fclose(file);
+
+   buffer.resize(size);
+   data = buffer.data();
+}
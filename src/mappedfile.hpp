@@ -0,0 +1,33 @@
+#ifndef __READERLP_MAPPEDFILE_HPP__
+#define __READERLP_MAPPEDFILE_HPP__
+
+#include <string>
+#include <vector>
+
+// read-only view of the complete contents of a file. regular files are
+// memory mapped, anything else (pipes, devices, ...) is read into an owned
+// buffer. the contents are not null-terminated.
+class MappedFile {
+private:
+   const char* data;
+   size_t size;
+   bool mapped;
+   std::vector<char> buffer;
+
+   bool map(const std::string& filename);
+   void read(const std::string& filename);
+
+   MappedFile(const MappedFile&);
+   MappedFile& operator=(const MappedFile&);
+
+public:
+   MappedFile(std::string filename);
+   ~MappedFile();
+
+   const char* begin() const { return data; }
+   const char* end() const { return data + size; }
+   size_t length() const { return size; }
+   bool ismapped() const { return mapped; }
+};
+
+#endif
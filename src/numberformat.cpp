@@ -0,0 +1,381 @@
+#include "numberformat.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+// grisu2 (Loitsch, "Printing floating-point numbers quickly and accurately
+// with integers", 2010): the digits are generated from 64 bit fixed point
+// approximations of the value and of the boundaries of its rounding interval.
+// the result always reads back to the same double and is the shortest such
+// representation in all but very few cases.
+
+struct DiyFp {
+   uint64_t f;
+   int e;
+
+   DiyFp(uint64_t f, int e) : f(f), e(e) {}
+
+   DiyFp operator-(const DiyFp& rhs) const {
+      return DiyFp(f - rhs.f, e);
+   }
+
+   // upper half of the 128 bit product, rounded
+   DiyFp operator*(const DiyFp& rhs) const {
+      const uint64_t M32 = 0xffffffffULL;
+      uint64_t a = f >> 32, b = f & M32;
+      uint64_t c = rhs.f >> 32, d = rhs.f & M32;
+      uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+      uint64_t tmp = (bd >> 32) + (ad & M32) + (bc & M32);
+      tmp += 1ULL << 31;
+      return DiyFp(ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), e + rhs.e + 64);
+   }
+};
+
+const int LP_DP_SIGNIFICAND_SIZE = 52;
+const int LP_DP_EXPONENT_BIAS = 0x3ff + LP_DP_SIGNIFICAND_SIZE;
+const int LP_DP_MIN_EXPONENT = -LP_DP_EXPONENT_BIAS;
+const uint64_t LP_DP_EXPONENT_MASK = 0x7ff0000000000000ULL;
+const uint64_t LP_DP_SIGNIFICAND_MASK = 0x000fffffffffffffULL;
+const uint64_t LP_DP_HIDDEN_BIT = 0x0010000000000000ULL;
+
+// normalized 10^k for k = -348, -340, ..., 340
+const uint64_t LP_CACHED_POWERS_F[] = {
+   0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL,
+   0xcf42894a5dce35eaULL, 0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL,
+   0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL, 0xbe5691ef416bd60cULL,
+   0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+   0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL,
+   0xc21094364dfb5637ULL, 0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL,
+   0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL, 0xb23867fb2a35b28eULL,
+   0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+   0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL,
+   0xb5b5ada8aaff80b8ULL, 0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL,
+   0x964e858c91ba2655ULL, 0xdff9772470297ebdULL, 0xa6dfbd9fb8e5b88fULL,
+   0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+   0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL,
+   0xaa242499697392d3ULL, 0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL,
+   0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL, 0x9c40000000000000ULL,
+   0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+   0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL,
+   0x9f4f2726179a2245ULL, 0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL,
+   0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL, 0x924d692ca61be758ULL,
+   0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+   0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL,
+   0x952ab45cfa97a0b3ULL, 0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL,
+   0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL, 0x88fcf317f22241e2ULL,
+   0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+   0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL,
+   0x8bab8eefb6409c1aULL, 0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL,
+   0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL, 0x80444b5e7aa7cf85ULL,
+   0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+   0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL
+};
+const int LP_CACHED_POWERS_E[] = {
+   -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980,
+   -954, -927, -901, -874, -847, -821, -794, -768, -741, -715,
+   -688, -661, -635, -608, -582, -555, -529, -502, -475, -449,
+   -422, -396, -369, -343, -316, -289, -263, -236, -210, -183,
+   -157, -130, -103, -77, -50, -24, 3, 30, 56, 83,
+   109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+   375, 402, 428, 455, 481, 508, 534, 561, 588, 614,
+   641, 667, 694, 720, 747, 774, 800, 827, 853, 880,
+   907, 933, 960, 986, 1013, 1039, 1066
+};
+
+const uint64_t LP_POWERS_OF_TEN[] = {
+   1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+   100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL,
+   10000000000000ULL, 100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+   100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL
+};
+
+DiyFp todiyfp(double value) {
+   uint64_t bits;
+   memcpy(&bits, &value, sizeof(bits));
+   int biasedexponent = (int)((bits & LP_DP_EXPONENT_MASK) >> LP_DP_SIGNIFICAND_SIZE);
+   uint64_t significand = bits & LP_DP_SIGNIFICAND_MASK;
+   if (biasedexponent != 0) {
+      return DiyFp(significand + LP_DP_HIDDEN_BIT, biasedexponent - LP_DP_EXPONENT_BIAS);
+   }
+   return DiyFp(significand, LP_DP_MIN_EXPONENT + 1);
+}
+
+DiyFp normalize(DiyFp v) {
+   while (!(v.f & LP_DP_HIDDEN_BIT)) {
+      v.f <<= 1;
+      v.e--;
+   }
+   v.f <<= 64 - LP_DP_SIGNIFICAND_SIZE - 1;
+   v.e -= 64 - LP_DP_SIGNIFICAND_SIZE - 1;
+   return v;
+}
+
+DiyFp normalizeboundary(DiyFp v) {
+   while (!(v.f & (LP_DP_HIDDEN_BIT << 1))) {
+      v.f <<= 1;
+      v.e--;
+   }
+   v.f <<= 64 - LP_DP_SIGNIFICAND_SIZE - 2;
+   v.e -= 64 - LP_DP_SIGNIFICAND_SIZE - 2;
+   return v;
+}
+
+// the boundaries m- and m+ halfway to the neighbouring doubles, sharing the exponent of m+
+void normalizedboundaries(const DiyFp& v, DiyFp& minus, DiyFp& plus) {
+   plus = normalizeboundary(DiyFp((v.f << 1) + 1, v.e - 1));
+   minus = v.f == LP_DP_HIDDEN_BIT ? DiyFp((v.f << 2) - 1, v.e - 2) : DiyFp((v.f << 1) - 1, v.e - 1);
+   minus.f <<= minus.e - plus.e;
+   minus.e = plus.e;
+}
+
+// cached power c = 10^-K such that the product with a value of binary
+// exponent e has its exponent in [-60, -32]
+DiyFp getcachedpower(int e, int& K) {
+   double dk = (-61 - e) * 0.30102999566398114 + 347;
+   int k = (int)dk;
+   if (dk - k > 0.0) {
+      k++;
+   }
+   unsigned int index = (unsigned int)((k >> 3) + 1);
+   K = -(-348 + (int)(index << 3));
+   return DiyFp(LP_CACHED_POWERS_F[index], LP_CACHED_POWERS_E[index]);
+}
+
+unsigned int countdecimaldigits(uint32_t n) {
+   unsigned int digits = 1;
+   while (digits < 10 && n >= LP_POWERS_OF_TEN[digits]) {
+      digits++;
+   }
+   return digits;
+}
+
+// moves the last digit towards w as long as the result stays in the interval
+void grisuround(char* buffer, int length, uint64_t delta, uint64_t rest, uint64_t tenkappa, uint64_t wpw) {
+   while (rest < wpw && delta - rest >= tenkappa
+   && (rest + tenkappa < wpw || wpw - rest > rest + tenkappa - wpw)) {
+      buffer[length - 1]--;
+      rest += tenkappa;
+   }
+}
+
+void digitgen(const DiyFp& W, const DiyFp& Mp, uint64_t delta, char* buffer, int& length, int& K) {
+   const DiyFp one(1ULL << -Mp.e, Mp.e);
+   const DiyFp wpw = Mp - W;
+   uint32_t p1 = (uint32_t)(Mp.f >> -one.e);
+   uint64_t p2 = Mp.f & (one.f - 1);
+   int kappa = (int)countdecimaldigits(p1);
+   length = 0;
+
+   // integral part
+   while (kappa > 0) {
+      // constant divisors, so that the divisions become multiplications
+      uint32_t d;
+      switch (kappa) {
+         case 10: d = p1 / 1000000000; p1 %= 1000000000; break;
+         case 9: d = p1 / 100000000; p1 %= 100000000; break;
+         case 8: d = p1 / 10000000; p1 %= 10000000; break;
+         case 7: d = p1 / 1000000; p1 %= 1000000; break;
+         case 6: d = p1 / 100000; p1 %= 100000; break;
+         case 5: d = p1 / 10000; p1 %= 10000; break;
+         case 4: d = p1 / 1000; p1 %= 1000; break;
+         case 3: d = p1 / 100; p1 %= 100; break;
+         case 2: d = p1 / 10; p1 %= 10; break;
+         case 1: d = p1; p1 = 0; break;
+         default: d = 0;
+      }
+      if (d || length) {
+         buffer[length++] = (char)('0' + d);
+      }
+      kappa--;
+      uint64_t rest = ((uint64_t)p1 << -one.e) + p2;
+      if (rest <= delta) {
+         K += kappa;
+         grisuround(buffer, length, delta, rest, LP_POWERS_OF_TEN[kappa] << -one.e, wpw.f);
+         return;
+      }
+   }
+
+   // fractional part
+   for (;;) {
+      p2 *= 10;
+      delta *= 10;
+      char d = (char)(p2 >> -one.e);
+      if (d || length) {
+         buffer[length++] = (char)('0' + d);
+      }
+      p2 &= one.f - 1;
+      kappa--;
+      if (p2 < delta) {
+         K += kappa;
+         int index = -kappa;
+         grisuround(buffer, length, delta, p2, one.f, wpw.f * (index < 20 ? LP_POWERS_OF_TEN[index] : 0));
+         return;
+      }
+   }
+}
+
+// digits and decimal exponent K of a positive finite value
+void grisu2(double value, char* buffer, int& length, int& K) {
+   const DiyFp v = todiyfp(value);
+   DiyFp wm(0, 0), wp(0, 0);
+   normalizedboundaries(v, wm, wp);
+
+   const DiyFp c = getcachedpower(wp.e, K);
+   const DiyFp W = normalize(v) * c;
+   DiyFp Wp = wp * c;
+   DiyFp Wm = wm * c;
+   Wm.f++;
+   Wp.f--;
+   digitgen(W, Wp, Wp.f - Wm.f, buffer, length, K);
+}
+
+char* writeexponent(int exponent, char* p) {
+   *p++ = 'e';
+   if (exponent < 0) {
+      *p++ = '-';
+      exponent = -exponent;
+   } else {
+      *p++ = '+';
+   }
+   if (exponent >= 100) {
+      *p++ = (char)('0' + exponent / 100);
+      exponent %= 100;
+      *p++ = (char)('0' + exponent / 10);
+   } else if (exponent >= 10) {
+      *p++ = (char)('0' + exponent / 10);
+   }
+   *p++ = (char)('0' + exponent % 10);
+   return p;
+}
+
+// places the decimal point into the digits [buffer, buffer + length) of
+// value digits * 10^K, switching to exponent notation for large and small values
+char* prettify(char* buffer, int length, int K) {
+   const int kk = length + K;   // 10^(kk-1) <= value < 10^kk
+
+   if (length <= kk && kk <= 21) {
+      // integer, 1234e7 -> 12340000000
+      memset(buffer + length, '0', (size_t)(kk - length));
+      return buffer + kk;
+   }
+
+   if (0 < kk && kk <= 21) {
+      // 1234e-2 -> 12.34
+      memmove(buffer + kk + 1, buffer + kk, (size_t)(length - kk));
+      buffer[kk] = '.';
+      return buffer + length + 1;
+   }
+
+   if (-6 < kk && kk <= 0) {
+      // 1234e-6 -> 0.001234
+      const int offset = 2 - kk;
+      memmove(buffer + offset, buffer, (size_t)length);
+      buffer[0] = '0';
+      buffer[1] = '.';
+      memset(buffer + 2, '0', (size_t)(offset - 2));
+      return buffer + length + offset;
+   }
+
+   if (length == 1) {
+      // 1e30
+      return writeexponent(kk - 1, buffer + 1);
+   }
+
+   // 1234e30 -> 1.234e33
+   memmove(buffer + 2, buffer + 1, (size_t)(length - 1));
+   buffer[1] = '.';
+   return writeexponent(kk - 1, buffer + length + 1);
+}
+
+char* formatdouble(double value, char* buffer) {
+   uint64_t bits;
+   memcpy(&bits, &value, sizeof(bits));
+   if (bits >> 63) {
+      *buffer++ = '-';
+      value = -value;
+   }
+
+   if (value == 0.0) {
+      *buffer = '0';
+      return buffer + 1;
+   }
+   if (value != value) {
+      memcpy(buffer, "nan", 3);
+      return buffer + 3;
+   }
+   if ((bits & LP_DP_EXPONENT_MASK) == LP_DP_EXPONENT_MASK) {
+      memcpy(buffer, "inf", 3);
+      return buffer + 3;
+   }
+
+   // integers, common for coefficients and bounds, need no digit generation
+   if (value < 1e15 && value == (double)(uint64_t)value) {
+      uint64_t n = (uint64_t)value;
+      char digits[20];
+      int length = 0;
+      do {
+         digits[length++] = (char)('0' + n % 10);
+         n /= 10;
+      } while (n > 0);
+      for (int i=0; i<length; i++) {
+         buffer[i] = digits[length - 1 - i];
+      }
+      return buffer + length;
+   }
+
+   int length, K;
+   grisu2(value, buffer, length, K);
+   return prettify(buffer, length, K);
+}
+
+const char LP_HEX_DIGITS[] = "0123456789abcdef";
+
+char* formathexdouble(double value, char* buffer) {
+   uint64_t bits;
+   memcpy(&bits, &value, sizeof(bits));
+   if (bits >> 63) {
+      *buffer++ = '-';
+      value = -value;
+   }
+
+   // zero, inf, nan and integers are written as formatdouble does
+   if (value == 0.0 || value != value || (bits & LP_DP_EXPONENT_MASK) == LP_DP_EXPONENT_MASK
+   || (value < 1e15 && value == (double)(uint64_t)value)) {
+      return formatdouble(value, buffer);
+   }
+
+   uint64_t significand = bits & LP_DP_SIGNIFICAND_MASK;
+   int exponent = (int)((bits & LP_DP_EXPONENT_MASK) >> LP_DP_SIGNIFICAND_SIZE);
+   memcpy(buffer, "0x", 2);
+   buffer += 2;
+   if (exponent == 0) {
+      // subnormal, 0x0.xxxp-1022 like %a
+      *buffer++ = '0';
+      exponent = 1;
+   } else {
+      *buffer++ = '1';
+   }
+   exponent -= 0x3ff;
+
+   if (significand != 0) {
+      *buffer++ = '.';
+      for (int shift = LP_DP_SIGNIFICAND_SIZE - 4; significand != 0; shift -= 4) {
+         *buffer++ = LP_HEX_DIGITS[(significand >> shift) & 0xf];
+         significand &= ((uint64_t)1 << shift) - 1;
+      }
+   }
+
+   *buffer++ = 'p';
+   *buffer++ = exponent < 0 ? '-' : '+';
+   unsigned int e = (unsigned int)(exponent < 0 ? -exponent : exponent);
+   char digits[4];
+   int length = 0;
+   do {
+      digits[length++] = (char)('0' + e % 10);
+      e /= 10;
+   } while (e > 0);
+   while (length > 0) {
+      *buffer++ = digits[--length];
+   }
+   return buffer;
+}
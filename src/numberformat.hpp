@@ -0,0 +1,17 @@
+#ifndef __READERLP_NUMBERFORMAT_HPP__
+#define __READERLP_NUMBERFORMAT_HPP__
+
+// enough room for any double written by formatdouble
+const unsigned int LP_MAX_NUMBER_LENGTH = 32;
+
+// writes value in a short decimal form that reads back to exactly the same
+// double, with a sign only if it is negative. returns the end of the output,
+// which is not null-terminated.
+char* formatdouble(double value, char* buffer);
+
+// writes value as a C99 hexadecimal float like 0x1.8p+1, which is exact and
+// needs no digit generation. zero, inf, nan and integers are written as by
+// formatdouble.
+char* formathexdouble(double value, char* buffer);
+
+#endif
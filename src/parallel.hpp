@@ -0,0 +1,62 @@
+#ifndef __READERLP_PARALLEL_HPP__
+#define __READERLP_PARALLEL_HPP__
+
+#include <exception>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+// number of threads to use for a request of n threads, 0 meaning one per core
+inline unsigned int getthreadcount(unsigned int n) {
+   if (n == 0) {
+      n = std::thread::hardware_concurrency();
+   }
+   return n > 0 ? n : 1;
+}
+
+// runs task(t) for t = 0, ..., n-1 concurrently, task 0 on the calling thread.
+// once all tasks are finished, the first exception thrown by one of them is
+// rethrown. tasks that do not get a thread of their own run on the caller.
+template <typename Task>
+void runparallel(unsigned int n, Task task) {
+   std::vector<std::exception_ptr> errors(n);
+   std::vector<std::thread> threads;
+   threads.reserve(n);
+
+   unsigned int t = 1;
+   try {
+      for (; t < n; t++) {
+         threads.push_back(std::thread([&task, &errors, t]() {
+            try {
+               task(t);
+            } catch (...) {
+               errors[t] = std::current_exception();
+            }
+         }));
+      }
+   } catch (const std::system_error&) {
+      // out of threads, the remaining tasks run below
+   }
+
+   for (unsigned int s = 0; s < n; s++) {
+      if (s > 0 && s < t) {
+         continue;
+      }
+      try {
+         task(s);
+      } catch (...) {
+         errors[s] = std::current_exception();
+      }
+   }
+
+   for (unsigned int s = 0; s < threads.size(); s++) {
+      threads[s].join();
+   }
+   for (unsigned int s = 0; s < n; s++) {
+      if (errors[s]) {
+         std::rethrow_exception(errors[s]);
+      }
+   }
+}
+
+#endif
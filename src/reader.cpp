@@ -1,14 +1,31 @@
 #include "reader.hpp"
 
+#include "arena.hpp"
 #include "builder.hpp"
+#include "cache.hpp"
+#include "compression.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstdio>
+#include <cstring>
+#include <exception>
+#include <istream>
 #include <limits>
-#include <map>
 #include <memory>
+#include <new>
+#include <system_error>
+#include <thread>
+#include <type_traits>
 #include <vector>
 
+#include <sys/stat.h>
+
 #include "def.hpp"
+#include "lexer.hpp"
+#include "mappedfile.hpp"
+#include "parallel.hpp"
 
 enum class RawTokenType {
    NONE,
@@ -29,22 +46,33 @@ enum class RawTokenType {
    ASTERISK
 };
 
+// tokens are flat records stored by value. strings are not copied but
+// referenced by their position and length in the input. the derived token
+// types only provide constructors, they add no data and may be sliced.
 struct RawToken {
    RawTokenType type;
-   inline bool istype(RawTokenType t) {
+   unsigned int length;    // STR: number of characters
+   double value;           // CONS
+   size_t position;        // offset of the token in the input
+
+   inline bool istype(RawTokenType t) const {
       return this->type == t;
    }
-   RawToken(RawTokenType t) : type(t) {} ;
+   RawToken(RawTokenType t, size_t p) : type(t), length(0), value(0.0), position(p) {};
 };
 
+static_assert(std::is_trivially_copyable<RawToken>::value, "raw tokens are stored by value");
+
 struct RawStringToken : RawToken {
-   std::string value;
-   RawStringToken(std::string v) : RawToken(RawTokenType::STR), value(v) {};
+   RawStringToken(size_t p, unsigned int l) : RawToken(RawTokenType::STR, p) {
+      length = l;
+   };
 };
 
 struct RawConstantToken : RawToken {
-   double value;
-   RawConstantToken(double v) : RawToken(RawTokenType::CONS), value(v) {};
+   RawConstantToken(double v, size_t p) : RawToken(RawTokenType::CONS, p) {
+      value = v;
+   };
 };
 
 enum class ProcessedTokenType {
@@ -81,226 +109,1194 @@ enum class LpComparisonType { LEQ, L, EQ, G, GEQ };
 
 struct ProcessedToken {
    ProcessedTokenType type;
-   ProcessedToken(ProcessedTokenType t) : type(t) {};
+   union {
+      LpSectionKeyword keyword;                  // SECID
+      LpComparisonType dir;                      // COMP
+      unsigned int length;                       // CONID, VARID: length of the name
+   };
+   union {
+      LpObjectiveSectionKeywordType objsense;    // SECID
+      double value;                              // CONST
+   };
+   size_t position;                              // offset of the (first) token in the input
+
+   ProcessedToken(ProcessedTokenType t, size_t p) : type(t), length(0), value(0.0), position(p) {};
 };
 
+static_assert(std::is_trivially_copyable<ProcessedToken>::value, "processed tokens are stored by value");
+
 struct ProcessedTokenSectionKeyword : ProcessedToken {
-   LpSectionKeyword keyword;
-   ProcessedTokenSectionKeyword(LpSectionKeyword k) : ProcessedToken(ProcessedTokenType::SECID), keyword(k) {};
+   ProcessedTokenSectionKeyword(LpSectionKeyword k, size_t p) : ProcessedToken(ProcessedTokenType::SECID, p) {
+      keyword = k;
+      objsense = LpObjectiveSectionKeywordType::NONE;
+   };
 };
 
 struct ProcessedTokenObjectiveSectionKeyword : ProcessedTokenSectionKeyword {
-   LpObjectiveSectionKeywordType objsense;
-   ProcessedTokenObjectiveSectionKeyword(LpObjectiveSectionKeywordType os) : ProcessedTokenSectionKeyword(LpSectionKeyword::OBJ), objsense(os) {};
+   ProcessedTokenObjectiveSectionKeyword(LpObjectiveSectionKeywordType os, size_t p) : ProcessedTokenSectionKeyword(LpSectionKeyword::OBJ, p) {
+      objsense = os;
+   };
 };
 
 struct ProcessedConsIdToken : ProcessedToken {
-   std::string name;
-   ProcessedConsIdToken(std::string n) : ProcessedToken(ProcessedTokenType::CONID), name(n) {};
+   ProcessedConsIdToken(size_t p, unsigned int l) : ProcessedToken(ProcessedTokenType::CONID, p) {
+      length = l;
+   };
 };
 
 struct ProcessedVarIdToken : ProcessedToken {
-   std::string name;
-   ProcessedVarIdToken(std::string n) : ProcessedToken(ProcessedTokenType::VARID), name(n) {};
+   ProcessedVarIdToken(size_t p, unsigned int l) : ProcessedToken(ProcessedTokenType::VARID, p) {
+      length = l;
+   };
 };
 
 struct ProcessedConstantToken : ProcessedToken {
-   double value;
-   ProcessedConstantToken(double v) : ProcessedToken(ProcessedTokenType::CONST), value(v) {};
+   ProcessedConstantToken(double v, size_t p) : ProcessedToken(ProcessedTokenType::CONST, p) {
+      value = v;
+   };
 };
 
 struct ProcessedComparisonToken : ProcessedToken {
-   LpComparisonType dir;
-   ProcessedComparisonToken(LpComparisonType d) : ProcessedToken(ProcessedTokenType::COMP), dir(d) {};
+   ProcessedComparisonToken(LpComparisonType d, size_t p) : ProcessedToken(ProcessedTokenType::COMP, p) {
+      dir = d;
+   };
+};
+
+// the longest sequence of raw tokens processtokens has to look at
+const unsigned int LP_MAX_RAW_LOOKAHEAD = 3;
+
+// the longest statement in the bounds section: CONST COMP VAR COMP CONST
+const unsigned int LP_MAX_BOUND_LENGTH = 5;
+
+// the constraint section is only split into chunks of at least this many bytes
+const size_t LP_READER_MIN_CHUNK_SIZE = 1 << 16;
+
+// with statistics, the phases of every this many steps of the parse are timed
+const unsigned int LP_STATS_SAMPLE_PERIOD = 16;
+
+// the comment header with the size of the model is looked for in this many lines
+const unsigned int LP_MAX_HEADER_LINES = 64;
+
+// fewest bytes of input per row, column or nonzero: a name or constant, a
+// comparison or sign and a separator
+const uint64_t LP_MIN_ITEM_LENGTH = 4;
+
+// the model reserved from the header takes at most this many bytes per byte
+// of input. real files need about one to one and a half.
+const uint64_t LP_MAX_RESERVED_PER_BYTE = 2;
+
+// streams are read in blocks of this size
+const size_t LP_STREAM_BLOCK_SIZE = 1 << 16;
+
+typedef std::chrono::steady_clock Clock;
+
+double elapsed(Clock::time_point start, Clock::time_point end) {
+   return std::chrono::duration<double>(end - start).count();
+}
+
+void addevent(ParseStats* stats, const std::string& name, unsigned int thread, Clock::time_point origin, Clock::time_point start, Clock::time_point end) {
+   ParseEvent event = {name, thread, elapsed(origin, start), elapsed(start, end)};
+   stats->events.push_back(event);
+}
+
+// deepest nesting of timed phases
+const unsigned int LP_MAX_PHASE_DEPTH = 8;
+
+// the phases being timed, innermost last. only the innermost one runs, the
+// time of those around it is stopped until it ends.
+struct PhaseStack {
+   double* phase[LP_MAX_PHASE_DEPTH];
+   Clock::time_point start[LP_MAX_PHASE_DEPTH];
+   unsigned int depth = 0;
+
+   void push(double* time) {
+      lpassert(depth < LP_MAX_PHASE_DEPTH);
+      Clock::time_point now = Clock::now();
+      if (depth > 0) {
+         *phase[depth-1] += elapsed(start[depth-1], now);
+      }
+      phase[depth] = time;
+      start[depth] = now;
+      depth++;
+   }
+
+   void pop() {
+      Clock::time_point now = Clock::now();
+      depth--;
+      *phase[depth] += elapsed(start[depth], now);
+      if (depth > 0) {
+         start[depth-1] = now;
+      }
+   }
+};
+
+// adds the wall time of its scope to a phase, except for the time of the
+// timers started within the scope. does nothing if there is no phase.
+class PhaseTimer {
+private:
+   PhaseStack& stack;
+   bool timed;
+
+public:
+   PhaseTimer(double* phase, PhaseStack& stack) : stack(stack), timed(phase != nullptr) {
+      if (timed) {
+         stack.push(phase);
+      }
+   }
+
+   ~PhaseTimer() {
+      if (timed) {
+         stack.pop();
+      }
+   }
 };
 
 class Reader {
 private:
-   FILE* file;
-   std::vector<std::unique_ptr<RawToken>> rawtokens;
-   std::vector<std::unique_ptr<ProcessedToken>> processedtokens;
-   std::map<LpSectionKeyword, std::vector<std::unique_ptr<ProcessedToken>>> sectiontokens;
-   
-   char linebuffer[LP_MAX_LINE_LENGTH+1];
-   bool linebufferrefill;
-   char* linebufferpos;
+   const char* data;       // start of the input, token positions are relative to it. streams move it as they grow
+   const char* inputpos;
+   const char* inputend;
+   StreamInput* stream = nullptr;  // input that arrives while it is read
+   unsigned int nthreads = 1;
+
+   // a chunk reader parses part of the constraint section and stops at the
+   // first section keyword, which is left to the main reader
+   bool ischunk = false;
+   bool stopped = false;
+   size_t stopposition = 0;
+   bool consplit = false;  // the constraint section was handed to chunk readers
+
+   // statistics, only collected if stats is set. the phases of single tokens
+   // are too short to time each of them, so only some steps of the parse are
+   // sampled, while the work done once per section is timed exactly.
+   ParseStats* stats = nullptr;
+   ParseStats sampled;
+   ParseStats exact;
+   bool sampling = false;
+   unsigned int nsteps = 0;
+   PhaseStack phasestack;
+   Clock::time_point origin;         // start of the parse
+   Clock::time_point sectionstart;
+   double paralleltime = 0.0;        // spent in readconsecparallel
+   unsigned int thread = 0;
+   uint64_t nrawtokens = 0;
+
+   // raw tokens not yet processed, at most a few beyond the lookahead
+   std::vector<RawToken> rawtokens;
+
+   // tokens of the current section that do not form a complete statement yet
+   std::vector<ProcessedToken> sectiontokens;
+   LpSectionKeyword currentsection = LpSectionKeyword::NONE;
+   unsigned int nsectiontokens[(int)LpSectionKeyword::END + 1] = {};
+
+   // sections are turned into model parts in the order of LpSectionKeyword,
+   // as that decides the numbering of the variables and which type wins. a
+   // section that comes too early in the file keeps its tokens until then.
+   bool seen[(int)LpSectionKeyword::END + 1] = {};
+   bool deferred[(int)LpSectionKeyword::END + 1] = {};
+   std::vector<ProcessedToken> deferredtokens[(int)LpSectionKeyword::END + 1];
 
    Builder builder;
 
-   void tokenize();
+   std::string tokenstring(const RawToken& token) const {
+      return std::string(data + token.position, token.length);
+   }
+   std::string tokenstring(const ProcessedToken& token) const {
+      return std::string(data + token.position, token.length);
+   }
+
+   bool isinfinity(const RawToken& token) const {
+      return token.istype(RawTokenType::STR) && lexkeyword(data + token.position, token.length) == LpKeyword::INF;
+   }
+
+   uint32_t getvarid(const ProcessedToken& token) {
+      return builder.getvarid(data + token.position, token.length);
+   }
+
+   Clock::time_point now() const {
+      return stats != nullptr ? Clock::now() : Clock::time_point();
+   }
+   void nextstep() {
+      sampling = stats != nullptr && nsteps++ % LP_STATS_SAMPLE_PERIOD == 0;
+   }
+   double* phase(double ParseStats::* time) {
+      return sampling ? &(sampled.*time) : nullptr;
+   }
+   double* sectionphase(bool final);
+   void endsectionevent(Clock::time_point end);
+   void addphasetimes(double time);
+   void collectstats();
+
    void readnexttoken(bool& done);
-   void processtokens();
-   void splittokens();
-   void processsections();
+   void processtokens(bool final);
+   void splittoken(const ProcessedToken& token);
+   void processsection(bool final);
+   bool mustdefer(LpSectionKeyword section) const;
+   void endsection();
+   void processdeferred();
    void processnonesec();
-   void processobjsec();
-   void processconsec();
-   void processboundssec();
+   void processobjsec(bool final);
+   void processconsec(bool final);
+   void processboundssec(bool final);
    void processbinsec();
    void processgensec();
    void processsemisec();
    void processsossec();
    void processendsec();
-   void parseexpression(std::vector<std::unique_ptr<ProcessedToken>>& tokens, std::shared_ptr<Expression> expr, unsigned int& i);
+   void parseexpression(std::vector<ProcessedToken>& tokens, unsigned int& i);
+   void readchunk();
+   void readconsecparallel();
+   void reserveheadercounts();
 
 public:
-   Reader(std::string filename) : file(fopen(filename.c_str(), "r")) {
-      lpassert(file != nullptr);
+   Reader(const char* begin, const char* end, unsigned int nthreads, ParseStats* stats, Clock::time_point origin) : data(begin), inputpos(begin), inputend(end), nthreads(nthreads), stats(stats), origin(origin) {};
+
+   // reader of input that is still arriving
+   Reader(StreamInput* stream, unsigned int nthreads, ParseStats* stats, Clock::time_point origin) : stream(stream), nthreads(nthreads), stats(stats), origin(origin) {
+      size_t available = stream->wait(0);
+      data = stream->begin();
+      inputpos = data;
+      inputend = data + available;
    };
 
-   ~Reader() {
-      fclose(file);
-   }
+   // chunk reader of the rows in [begin, end) of the constraint section of data
+   Reader(const char* data, const char* begin, const char* end) : data(data), inputpos(begin), inputend(end), ischunk(true), currentsection(LpSectionKeyword::CON) {};
+
+   // the instance goes to handler rather than into the returned model
+   void sethandler(ParseHandler* handler) { builder.handler = handler; }
 
-   Model read();
+   CompactModel read();
 };
 
-Model readinstance(std::string filename) {
-   Reader reader(filename);
+// parses [begin, end), which may be compressed. a handler gets the
+// constraints in order, so they are not split among threads then.
+CompactModel parsebuffer(const char* begin, const char* end, unsigned int nthreads, ParseStats* stats, Clock::time_point origin, ParseHandler* handler = nullptr) {
+   if (handler != nullptr) {
+      nthreads = 1;
+   }
+   Compression compression = detectcompression(begin, end - begin);
+   if (compression != Compression::NONE) {
+      lpassert(supportscompression(compression));
+      DecompressedInput stream(begin, end - begin, compression);
+      Reader reader(&stream, getthreadcount(nthreads), stats, origin);
+      reader.sethandler(handler);
+      return reader.read();
+   }
+
+   Reader reader(begin, end, getthreadcount(nthreads), stats, origin);
+   reader.sethandler(handler);
    return reader.read();
 }
 
-bool isstrequalnocase(const std::string str1, const std::string str2) {
-   size_t len = str1.size();
-    if (str2.size() != len)
-        return false;
-    for (size_t i = 0; i < len; ++i)
-        if (tolower(str1[i]) != tolower(str2[i]))
-            return false;
-    return true;
+// mapped files are only read once they are accessed, their page faults count as tokenizing
+CompactModel parseinstance(std::string filename, unsigned int nthreads, ParseStats* stats, Clock::time_point origin) {
+   Clock::time_point start = stats != nullptr ? Clock::now() : origin;
+   MappedFile input(filename);
+   if (stats != nullptr) {
+      Clock::time_point end = Clock::now();
+      stats->iotime += elapsed(start, end);
+      stats->bytes = input.length();
+      addevent(stats, "read file", 0, origin, start, end);
+   }
+   return parsebuffer(input.begin(), input.end(), nthreads, stats, origin);
 }
 
-bool iskeyword(const std::string str, const std::string* keywords, const int nkeywords) {
-   for (int i=0; i<nkeywords; i++) {
-      if (isstrequalnocase(str, keywords[i])) {
-         return true;
+// resets stats and returns the start of the parse
+Clock::time_point startstats(ParseStats* stats) {
+   if (stats == nullptr) {
+      return Clock::time_point();
+   }
+   *stats = ParseStats();
+   return Clock::now();
+}
+
+void finishstats(ParseStats* stats, const CompactModel& model, Clock::time_point origin) {
+   if (stats != nullptr) {
+      stats->variables = model.ncols();
+      stats->constraints = model.nrows();
+      stats->nonzeros = model.nnz();
+      stats->totaltime = elapsed(origin, Clock::now());
+   }
+}
+
+// creates the Model of a parse, timed as part of it
+Model createmodel(const CompactModel& compact, ParseStats* stats) {
+   if (stats == nullptr) {
+      return createmodel(compact);
+   }
+
+   Clock::time_point start = Clock::now();
+   Model model = createmodel(compact);
+   double time = elapsed(start, Clock::now());
+   ParseEvent event = {"create model", 0, stats->totaltime, time};
+   stats->events.push_back(event);
+   stats->createmodeltime += time;
+   stats->totaltime += time;
+   return model;
+}
+
+// the same for the ArenaModel of a parse
+ArenaModel createarenamodel(const CompactModel& compact, size_t blocksize, ParseStats* stats) {
+   if (stats == nullptr) {
+      return createarenamodel(compact, blocksize);
+   }
+
+   Clock::time_point start = Clock::now();
+   ArenaModel model = createarenamodel(compact, blocksize);
+   double time = elapsed(start, Clock::now());
+   ParseEvent event = {"create model", 0, stats->totaltime, time};
+   stats->events.push_back(event);
+   stats->createmodeltime += time;
+   stats->totaltime += time;
+   stats->arenamemory = model.arena->usage().reserved;
+   return model;
+}
+
+Model readinstance(std::string filename) {
+   return createmodel(readcompactinstance(filename));
+}
+
+CompactModel readcompactinstance(std::string filename) {
+   return parseinstance(filename, 1, nullptr, Clock::time_point());
+}
+
+Model readinstance(std::string filename, const ReaderOptions& options) {
+   return createmodel(readcompactinstance(filename, options), options.stats);
+}
+
+ArenaModel readarenainstance(std::string filename, const ReaderOptions& options) {
+   return createarenamodel(readcompactinstance(filename, options), options.arenablocksize, options.stats);
+}
+
+CompactModel readcompactinstance(std::string filename, const ReaderOptions& options) {
+   ParseStats* stats = options.stats;
+   Clock::time_point origin = startstats(stats);
+
+   CompactModel model;
+   if (options.cachedirectory.empty()) {
+      model = parseinstance(filename, options.nthreads, stats, origin);
+   } else {
+      ParseCache cache(options.cachedirectory, options.cachebudget);
+      Clock::time_point start = stats != nullptr ? Clock::now() : origin;
+      bool hit = cache.lookup(filename, model);
+      if (stats != nullptr) {
+         Clock::time_point end = Clock::now();
+         stats->cachetime += elapsed(start, end);
+         addevent(stats, hit ? "cache hit" : "cache miss", 0, origin, start, end);
+      }
+      if (!hit) {
+         model = parseinstance(filename, options.nthreads, stats, origin);
+         start = stats != nullptr ? Clock::now() : origin;
+         cache.store(model);
+         if (stats != nullptr) {
+            Clock::time_point end = Clock::now();
+            stats->cachetime += elapsed(start, end);
+            addevent(stats, "cache store", 0, origin, start, end);
+         }
       }
    }
-   return false;
+
+   finishstats(stats, model, origin);
+   return model;
 }
 
-LpObjectiveSectionKeywordType parseobjectivesectionkeyword(const std::string str) {
-   if (iskeyword(str, LP_KEYWORD_MIN, LP_KEYWORD_MIN_N)) {
-      return LpObjectiveSectionKeywordType::MIN;
+Model readinstance(const char* data, size_t length) {
+   return createmodel(readcompactinstance(data, length));
+}
+
+Model readinstance(const char* data, size_t length, const ReaderOptions& options) {
+   return createmodel(readcompactinstance(data, length, options), options.stats);
+}
+
+CompactModel readcompactinstance(const char* data, size_t length) {
+   return parsebuffer(data, data + length, 1, nullptr, Clock::time_point());
+}
+
+// the buffer is parsed in place, tokens refer to it until the model is built
+CompactModel readcompactinstance(const char* data, size_t length, const ReaderOptions& options) {
+   ParseStats* stats = options.stats;
+   Clock::time_point origin = startstats(stats);
+   if (stats != nullptr) {
+      stats->bytes = length;
    }
+   CompactModel model = parsebuffer(data, data + length, options.nthreads, stats, origin);
+   finishstats(stats, model, origin);
+   return model;
+}
+
+Model readinstance(std::istream& input) {
+   return createmodel(readcompactinstance(input));
+}
+
+Model readinstance(std::istream& input, const ReaderOptions& options) {
+   return createmodel(readcompactinstance(input, options), options.stats);
+}
+
+CompactModel readcompactinstance(std::istream& input) {
+   return readcompactinstance(input, ReaderOptions());
+}
 
-   if (iskeyword(str, LP_KEYWORD_MAX, LP_KEYWORD_MAX_N)) {
-      return LpObjectiveSectionKeywordType::MAX;
+// the stream is parsed while it is read
+CompactModel readcompactinstance(std::istream& input, const ReaderOptions& options) {
+   IncrementalReader reader(options);
+   std::vector<char> block(LP_STREAM_BLOCK_SIZE);
+   while (input.read(block.data(), block.size()) || input.gcount() > 0) {
+      reader.feed(block.data(), input.gcount());
    }
-   
-   return LpObjectiveSectionKeywordType::NONE;
+   lpassert(!input.bad());
+   return reader.finish();
 }
 
-LpSectionKeyword parsesectionkeyword(const std::string& str) {
-   if (parseobjectivesectionkeyword(str) != LpObjectiveSectionKeywordType::NONE) {
-      return LpSectionKeyword::OBJ;
+struct IncrementalReader::State {
+   ReaderOptions options;
+   Clock::time_point origin;
+   PushInput input;
+   bool started = false;     // the compression of the input is known
+   bool streaming = false;   // the input is parsed on a thread while it arrives
+   bool finished = false;
+   std::thread thread;
+   CompactModel model;
+   std::exception_ptr error;
+
+   void start();
+};
+
+// compressed input and input that cannot be reserved address space for is
+// only parsed once it is complete
+void IncrementalReader::State::start() {
+   started = true;
+   if (detectcompression(input.contents(), input.length()) != Compression::NONE || !input.isstreaming()) {
+      return;
+   }
+   try {
+      thread = std::thread([this]() {
+         try {
+            Reader reader(&input, getthreadcount(options.nthreads), options.stats, origin);
+            model = reader.read();
+         } catch (...) {
+            error = std::current_exception();
+            input.cancel();
+         }
+      });
+      streaming = true;
+   } catch (const std::system_error&) {
+      // out of threads, parsed with finish
    }
+}
+
+IncrementalReader::IncrementalReader() : IncrementalReader(ReaderOptions()) {
+}
+
+IncrementalReader::IncrementalReader(const ReaderOptions& options) : state(new State) {
+   state->options = options;
+   state->origin = startstats(options.stats);
+}
 
-   if (iskeyword(str, LP_KEYWORD_ST, LP_KEYWORD_ST_N)) {
-      return LpSectionKeyword::CON;
+IncrementalReader::~IncrementalReader() {
+   if (state->thread.joinable()) {
+      state->input.cancel();
+      state->thread.join();
    }
+   delete state;
+}
 
-   if (iskeyword(str, LP_KEYWORD_BOUNDS, LP_KEYWORD_BOUNDS_N)) {
-      return LpSectionKeyword::BOUNDS;
+void IncrementalReader::feed(const char* data, size_t length) {
+   lpassert(!state->finished);
+   if (!state->input.push(data, length)) {
+      // the reader stopped at an error
+      state->finished = true;
+      state->thread.join();
+      std::rethrow_exception(state->error);
+   }
+   if (!state->started && state->input.length() >= LP_MAX_MAGIC_LENGTH) {
+      state->start();
    }
+}
 
-   if (iskeyword(str, LP_KEYWORD_BIN, LP_KEYWORD_BIN_N)) {
-      return LpSectionKeyword::BIN;
+CompactModel IncrementalReader::finish() {
+   lpassert(!state->finished);
+   state->finished = true;
+   if (!state->started) {
+      state->start();
+   }
+   state->input.finish();
+
+   ParseStats* stats = state->options.stats;
+   CompactModel model;
+   if (state->streaming) {
+      state->thread.join();
+      if (state->error) {
+         std::rethrow_exception(state->error);
+      }
+      model = std::move(state->model);
+   } else {
+      const char* begin = state->input.begin();
+      model = parsebuffer(begin, begin + state->input.length(), state->options.nthreads, stats, state->origin);
+   }
+   if (stats != nullptr) {
+      stats->bytes = state->input.length();
    }
+   finishstats(stats, model, state->origin);
+   return model;
+}
+
+void readinstance(std::string filename, ParseHandler& handler) {
+   MappedFile input(filename);
+   parsebuffer(input.begin(), input.end(), 1, nullptr, Clock::time_point(), &handler);
+}
+
+void readinstance(const char* data, size_t length, ParseHandler& handler) {
+   parsebuffer(data, data + length, 1, nullptr, Clock::time_point(), &handler);
+}
+
+// size of the file in bytes, 0 if unknown
+uint64_t batchfilesize(const std::string& filename) {
+   struct stat st;
+   return stat(filename.c_str(), &st) == 0 ? (uint64_t)st.st_size : 0;
+}
 
-   if (iskeyword(str, LP_KEYWORD_GEN, LP_KEYWORD_GEN_N)) {
-      return LpSectionKeyword::GEN;
+// reads the files on a pool of threads, each taking the largest file left
+// whenever it is done with one, so that no big file is left to run alone
+// at the end. the files themselves are read serially.
+template <typename Instance>
+void readbatch(const std::vector<std::string>& filenames, const ReaderOptions& options, Instance (*read)(std::string, const ReaderOptions&), const BatchCallback<Instance>& callback) {
+   std::vector<uint64_t> sizes(filenames.size());
+   std::vector<size_t> order(filenames.size());
+   for (size_t i=0; i<filenames.size(); i++) {
+      sizes[i] = batchfilesize(filenames[i]);
+      order[i] = i;
    }
+   std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sizes[a] > sizes[b]; });
+
+   ReaderOptions fileoptions = options;
+   fileoptions.nthreads = 1;
+   fileoptions.stats = nullptr;
+   std::atomic<size_t> next(0);
+   unsigned int nthreads = (unsigned int)std::min((size_t)getthreadcount(options.nthreads), filenames.size());
+   runparallel(nthreads, [&](unsigned int) {
+      for (size_t k = next++; k < order.size(); k = next++) {
+         size_t i = order[k];
+         Instance instance;
+         std::exception_ptr error;
+         try {
+            instance = read(filenames[i], fileoptions);
+         } catch (...) {
+            error = std::current_exception();
+         }
+         callback(i, instance, error);
+      }
+   });
+}
 
-   if (iskeyword(str, LP_KEYWORD_SEMI, LP_KEYWORD_SEMI_N)) {
-      return LpSectionKeyword::SEMI;
+// collects the instances, the first error in file order is rethrown
+template <typename Instance>
+std::vector<Instance> readbatch(const std::vector<std::string>& filenames, const ReaderOptions& options, Instance (*read)(std::string, const ReaderOptions&)) {
+   std::vector<Instance> instances(filenames.size());
+   std::vector<std::exception_ptr> errors(filenames.size());
+   readbatch<Instance>(filenames, options, read, [&](size_t i, Instance& instance, std::exception_ptr error) {
+      instances[i] = std::move(instance);
+      errors[i] = error;
+   });
+   for (size_t i=0; i<errors.size(); i++) {
+      if (errors[i]) {
+         std::rethrow_exception(errors[i]);
+      }
    }
+   return instances;
+}
+
+std::vector<Model> readinstances(const std::vector<std::string>& filenames, const ReaderOptions& options) {
+   return readbatch<Model>(filenames, options, readinstance);
+}
+
+void readinstances(const std::vector<std::string>& filenames, const ReaderOptions& options, const BatchCallback<Model>& callback) {
+   readbatch<Model>(filenames, options, readinstance, callback);
+}
+
+std::vector<CompactModel> readcompactinstances(const std::vector<std::string>& filenames, const ReaderOptions& options) {
+   return readbatch<CompactModel>(filenames, options, readcompactinstance);
+}
 
-   if (iskeyword(str, LP_KEYWORD_SOS, LP_KEYWORD_SOS_N)) {
-      return LpSectionKeyword::SOS;
+void readcompactinstances(const std::vector<std::string>& filenames, const ReaderOptions& options, const BatchCallback<CompactModel>& callback) {
+   readbatch<CompactModel>(filenames, options, readcompactinstance, callback);
+}
+
+void writetrace(std::string filename, const ParseStats& stats) {
+   FILE* file = fopen(filename.c_str(), "w");
+   lpassert(file != nullptr);
+   fprintf(file, "{\"traceEvents\":[");
+   for (size_t i=0; i<stats.events.size(); i++) {
+      const ParseEvent& event = stats.events[i];
+      fprintf(file, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+         i > 0 ? "," : "", event.name.c_str(), event.thread, event.start * 1e6, event.duration * 1e6);
    }
+   fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+   lpassert(fclose(file) == 0);
+}
 
-   if (iskeyword(str, LP_KEYWORD_END, LP_KEYWORD_END_N)) {
-      return LpSectionKeyword::END;
+// the section a keyword starts, NONE for the keywords within sections
+LpSectionKeyword sectionkeyword(LpKeyword keyword) {
+   switch (keyword) {
+      case LpKeyword::MIN:
+      case LpKeyword::MAX:
+         return LpSectionKeyword::OBJ;
+      case LpKeyword::ST:
+         return LpSectionKeyword::CON;
+      case LpKeyword::BOUNDS:
+         return LpSectionKeyword::BOUNDS;
+      case LpKeyword::BIN:
+         return LpSectionKeyword::BIN;
+      case LpKeyword::GEN:
+         return LpSectionKeyword::GEN;
+      case LpKeyword::SEMI:
+         return LpSectionKeyword::SEMI;
+      case LpKeyword::SOS:
+         return LpSectionKeyword::SOS;
+      case LpKeyword::END:
+         return LpSectionKeyword::END;
+      default:
+         return LpSectionKeyword::NONE;
    }
+}
+
+// totals of the comment header GAMS writes (QPLIB files among them), such as
+//    \ Equation counts
+//    \     Total        E        G        L        N        X        C        B
+//    \     11999        0     4000     7999        0        0        0        0
+// each total is the first number following the title of its block, 0 if
+// it is not given.
+struct HeaderCounts {
+   uint64_t rows = 0;
+   uint64_t cols = 0;
+   uint64_t nonzeros = 0;
+};
 
-   return LpSectionKeyword::NONE;
+bool startswith(const char* pos, const char* end, const char* prefix) {
+   size_t length = strlen(prefix);
+   return (size_t)(end - pos) >= length && memcmp(pos, prefix, length) == 0;
+}
+
+HeaderCounts parseheadercounts(const char* pos, const char* end) {
+   HeaderCounts counts;
+   uint64_t* total = nullptr;
+   for (unsigned int line=0; line<LP_MAX_HEADER_LINES && pos < end && *pos == '\\'; line++) {
+      const char* lineend = (const char*)memchr(pos, '\n', end - pos);
+      if (lineend == nullptr) {
+         lineend = end;
+      }
+      pos++;
+      while (pos < lineend && (*pos == ' ' || *pos == '\t')) {
+         pos++;
+      }
+      if (startswith(pos, lineend, "Equation counts")) {
+         total = &counts.rows;
+      } else if (startswith(pos, lineend, "Variable counts")) {
+         total = &counts.cols;
+      } else if (startswith(pos, lineend, "Nonzero counts")) {
+         total = &counts.nonzeros;
+      } else if (total != nullptr && pos < lineend && *pos >= '0' && *pos <= '9') {
+         *total = 0;
+         for (; pos < lineend && *pos >= '0' && *pos <= '9' && *total < UINT32_MAX; pos++) {
+            *total = 10 * *total + (*pos - '0');
+         }
+         total = nullptr;
+      }
+      pos = lineend + (lineend < end);
+   }
+   return counts;
 }
 
-Model Reader::read() {
-   tokenize();
-   processtokens();
-   splittokens();
-   processsections();
+// the counts are only a hint. they are capped by what the input can hold,
+// so that a wrong header costs memory at worst, and it never changes the result.
+void Reader::reserveheadercounts() {
+   if (ischunk || stream != nullptr) {
+      return;
+   }
+   // the header may be wrong, so no count goes beyond what the input can
+   // hold, nor all of them together beyond a multiple of its size, and
+   // running out of memory only means nothing is reserved
+   HeaderCounts counts = parseheadercounts(inputpos, inputend);
+   uint64_t length = inputend - inputpos;
+   uint64_t maxitems = length / LP_MIN_ITEM_LENGTH;
+   try {
+      builder.reserve((size_t)std::min(counts.rows, maxitems), (size_t)std::min(counts.cols, maxitems), (size_t)std::min(counts.nonzeros, maxitems),
+         (size_t)(length * LP_MAX_RESERVED_PER_BYTE));
+   } catch (const std::bad_alloc&) {
+      builder.model = CompactModel();
+      builder.variables = SymbolTable();
+   }
+}
 
-   return builder.model;
+// single pass over the input: every raw token is processed as soon as the
+// lookahead allows it, and every statement is turned into model parts as
+// soon as its last token has been seen
+CompactModel Reader::read() {
+   Clock::time_point start = now();
+   sectionstart = start;
+   reserveheadercounts();
+   bool done = false;
+   while (!done) {
+      nextstep();
+      {
+         PhaseTimer timer(phase(&ParseStats::tokenizetime), phasestack);
+         readnexttoken(done);
+      }
+      processtokens(done);
+      if (!done && !consplit && currentsection == LpSectionKeyword::CON && !deferred[(int)LpSectionKeyword::CON] && nsectiontokens[(int)LpSectionKeyword::CON] == 0) {
+         consplit = true;
+         if (nthreads > 1) {
+            readconsecparallel();
+         }
+      }
+   }
+   sampling = false;
+   endsection();
+   endsectionevent(now());
+   processdeferred();
+
+   Clock::time_point finishstart = now();
+   CompactModel& model = builder.finish();
+   if (stats != nullptr) {
+      Clock::time_point end = Clock::now();
+      addphasetimes(elapsed(start, finishstart) - paralleltime);
+      stats->finishtime += elapsed(finishstart, end);
+      addevent(stats, "finish", thread, origin, finishstart, end);
+      collectstats();
+   }
+   return std::move(model);
+}
+
+void Reader::readchunk() {
+   Clock::time_point start = now();
+   bool done = false;
+   while (!done && !stopped) {
+      nextstep();
+      {
+         PhaseTimer timer(phase(&ParseStats::tokenizetime), phasestack);
+         readnexttoken(done);
+      }
+      processtokens(done);
+   }
+   if (!stopped) {
+      sampling = false;
+      processsection(true);
+      // an embedded null character ends the input early
+      stopped = inputpos != inputend;
+      stopposition = inputpos - data;
+   }
+   if (stats != nullptr) {
+      Clock::time_point end = Clock::now();
+      addphasetimes(elapsed(start, end));
+      addevent(stats, "constraints chunk", thread, origin, start, end);
+      collectstats();
+   }
+}
+
+// the end of a section is timed exactly, the statements within it are sampled
+double* Reader::sectionphase(bool final) {
+   ParseStats* times = stats == nullptr ? nullptr : final ? &exact : sampling ? &sampled : nullptr;
+   if (times == nullptr) {
+      return nullptr;
+   }
+   switch (currentsection) {
+      case LpSectionKeyword::OBJ:
+         return &times->objsectime;
+      case LpSectionKeyword::CON:
+         return &times->consectime;
+      case LpSectionKeyword::BOUNDS:
+         return &times->boundssectime;
+      case LpSectionKeyword::GEN:
+         return &times->gensectime;
+      case LpSectionKeyword::BIN:
+         return &times->binsectime;
+      case LpSectionKeyword::SEMI:
+         return &times->semisectime;
+      case LpSectionKeyword::SOS:
+         return &times->sossectime;
+      default:
+         // nothing to do, counts as splitting
+         return nullptr;
+   }
+}
+
+// splits time, the wall time of the parse loop, among the phases. what is not
+// timed exactly is divided in proportion to the samples.
+void Reader::addphasetimes(double time) {
+   static double ParseStats::* const phases[] = {
+      &ParseStats::tokenizetime, &ParseStats::processtokenstime, &ParseStats::splittokenstime,
+      &ParseStats::objsectime, &ParseStats::consectime, &ParseStats::boundssectime,
+      &ParseStats::gensectime, &ParseStats::binsectime, &ParseStats::semisectime, &ParseStats::sossectime
+   };
+   const size_t nphases = sizeof(phases) / sizeof(phases[0]);
+
+   double exacttime = 0.0;
+   double sampledtime = 0.0;
+   for (size_t p=0; p<nphases; p++) {
+      exacttime += exact.*phases[p];
+      sampledtime += sampled.*phases[p];
+   }
+   double scale = sampledtime > 0.0 ? std::max(time - exacttime, 0.0) / sampledtime : 0.0;
+   for (size_t p=0; p<nphases; p++) {
+      stats->*phases[p] += exact.*phases[p] + sampled.*phases[p] * scale;
+   }
+}
+
+void Reader::endsectionevent(Clock::time_point end) {
+   static const char* names[] = {"", "objective", "constraints", "bounds", "general", "binary", "semi-continuous", "sos", "end"};
+   if (stats != nullptr && currentsection != LpSectionKeyword::NONE) {
+      addevent(stats, names[(int)currentsection], thread, origin, sectionstart, end);
+   }
+   sectionstart = end;
+}
+
+// the counts that are kept anyway, times are measured as the parse goes
+void Reader::collectstats() {
+   stats->rawtokens += nrawtokens;
+   for (int s=0; s<=(int)LpSectionKeyword::END; s++) {
+      stats->processedtokens += nsectiontokens[s];
+   }
+   stats->tokenmemory += rawtokens.capacity() * sizeof(RawToken) + sectiontokens.capacity() * sizeof(ProcessedToken);
+   for (int s=0; s<=(int)LpSectionKeyword::END; s++) {
+      stats->tokenmemory += deferredtokens[s].capacity() * sizeof(ProcessedToken);
+   }
+}
+
+inline bool islinespace(char c) {
+   return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline bool iscomparisoncharacter(char c) {
+   return c == '<' || c == '>' || c == '=';
+}
+
+// whether the line [begin, end) ends a row, with a comparison between a
+// variable and a constant like "x + y <= 5". a constant before the
+// comparison may be the first bound of a ranged row, so that does not count.
+bool endsrow(const char* begin, const char* end) {
+   const char* comparison = end;
+   while (comparison > begin && !iscomparisoncharacter(comparison[-1])) {
+      comparison--;
+   }
+   if (comparison == begin) {
+      return false;
+   }
+
+   // the right hand side: a number or infinity, possibly signed
+   const char* p = comparison;
+   while (p < end && islinespace(*p)) {
+      p++;
+   }
+   if (p < end && (*p == '+' || *p == '-')) {
+      p++;
+      while (p < end && islinespace(*p)) {
+         p++;
+      }
+   }
+   double value;
+   const char* valueend = lexnumber(p, end, value);
+   if (valueend == p) {
+      valueend = lexidentifier(p, end);
+      if (lexkeyword(p, valueend - p) != LpKeyword::INF) {
+         return false;
+      }
+   }
+   while (valueend < end && islinespace(*valueend)) {
+      valueend++;
+   }
+   if (valueend != end) {
+      return false;
+   }
+
+   // a variable name before the comparison
+   const char* nameend = comparison;
+   while (nameend > begin && iscomparisoncharacter(nameend[-1])) {
+      nameend--;
+   }
+   while (nameend > begin && islinespace(nameend[-1])) {
+      nameend--;
+   }
+   const char* namestart = nameend;
+   while (namestart > begin && !isidentifierdelimiter(namestart[-1])) {
+      namestart--;
+   }
+   return namestart != nameend && lexnumber(namestart, nameend, value) == namestart
+      && lexkeyword(namestart, nameend - namestart) == LpKeyword::NONE;
+}
+
+// end of the part of the line [begin, end) before a comment
+const char* linecontentend(const char* begin, const char* end) {
+   const char* comment = (const char*)memchr(begin, '\\', end - begin);
+   return comment == nullptr ? end : comment;
+}
+
+// start of the first line after pos that begins a row, or end if there is
+// none. that is a line starting with a constraint name, or one following a
+// line that ends a row, so that the rows before and after that line can be
+// parsed independently. comments are not looked at, and lines with nothing
+// else are skipped.
+const char* findrowstart(const char* pos, const char* end, const char* data) {
+   // the line pos is in is looked at in full
+   while (pos > data && pos[-1] != '\n') {
+      pos--;
+   }
+   bool previousendsrow = false;
+   while (pos < end) {
+      const char* lineend = (const char*)memchr(pos, '\n', end - pos);
+      if (lineend == nullptr) {
+         break;
+      }
+      const char* contentend = linecontentend(pos, lineend);
+      const char* contentstart = pos;
+      while (contentstart < contentend && islinespace(*contentstart)) {
+         contentstart++;
+      }
+      if (contentstart < contentend) {
+         previousendsrow = endsrow(contentstart, contentend);
+      }
+      pos = lineend + 1;
+
+      const char* nextend = (const char*)memchr(pos, '\n', end - pos);
+      nextend = linecontentend(pos, nextend == nullptr ? end : nextend);
+      const char* namestart = pos;
+      while (namestart < nextend && islinespace(*namestart)) {
+         namestart++;
+      }
+      if (namestart == nextend) {
+         continue;
+      }
+      if (previousendsrow && !iscomparisoncharacter(*namestart)) {
+         return pos;
+      }
+      double value;
+      if (lexnumber(namestart, nextend, value) != namestart) {
+         continue;
+      }
+      const char* nameend = lexidentifier(namestart, nextend);
+      if (nameend == namestart) {
+         continue;
+      }
+      while (nameend < nextend && islinespace(*nameend)) {
+         nameend++;
+      }
+      if (nameend < nextend && *nameend == ':') {
+         return pos;
+      }
+   }
+   return end;
+}
+
+// the quadratic part of a row, with the columns renumbered
+Hessian remaphessian(const Hessian& hessian, const std::vector<uint32_t>& columns) {
+   QuadraticPart quad;
+   for (uint32_t col=0; col<hessian.ncols(); col++) {
+      for (size_t k=hessian.start[col]; k<hessian.start[col+1]; k++) {
+         uint32_t row = hessian.index[k];
+         quad.index1.push_back(columns[row]);
+         quad.index2.push_back(columns[col]);
+         quad.value.push_back(row == col ? hessian.value[k] : 2.0 * hessian.value[k]);
+      }
+   }
+   return createhessian(quad, 0);
+}
+
+// the rest of the input is split at row starts into one chunk per thread, and
+// each chunk is parsed on its own up to the end of the constraint section. the
+// rows of the chunks are then appended in order, with the variables of each
+// chunk numbered in order of first appearance, just like a single pass does.
+// chunks beyond the end of the section are discarded, along with their errors.
+void Reader::readconsecparallel() {
+   Clock::time_point parallelstart = now();
+   if (stream != nullptr) {
+      size_t position = inputpos - data;
+      size_t available = stream->waitall();
+      data = stream->begin();
+      inputpos = data + position;
+      inputend = data + available;
+   }
+   const char* begin = rawtokens.empty() ? inputpos : data + rawtokens[0].position;
+   size_t length = inputend - begin;
+   size_t nchunks = std::min((size_t)nthreads, length / LP_READER_MIN_CHUNK_SIZE);
+
+   std::vector<const char*> chunkstart(1, begin);
+   for (size_t c=1; c<nchunks; c++) {
+      const char* target = begin + length / nchunks * c;
+      if (target > chunkstart.back()) {
+         const char* start = findrowstart(target, inputend, chunkstart.back());
+         if (start == inputend) {
+            break;
+         }
+         chunkstart.push_back(start);
+      }
+   }
+   chunkstart.push_back(inputend);
+   nchunks = chunkstart.size() - 1;
+   if (nchunks < 2) {
+      return;
+   }
+
+   std::vector<std::unique_ptr<Reader>> chunks(nchunks);
+   std::vector<std::exception_ptr> errors(nchunks);
+   std::vector<ParseStats> chunkstats(stats != nullptr ? nchunks : 0);
+   runparallel((unsigned int)nchunks, [&](unsigned int c) {
+      try {
+         chunks[c].reset(new Reader(data, chunkstart[c], chunkstart[c+1]));
+         if (stats != nullptr) {
+            chunks[c]->stats = &chunkstats[c];
+            chunks[c]->origin = origin;
+            chunks[c]->thread = c + 1;
+         }
+         chunks[c]->readchunk();
+      } catch (...) {
+         errors[c] = std::current_exception();
+      }
+   });
+
+   size_t nused = 0;
+   while (nused < nchunks) {
+      if (errors[nused]) {
+         std::rethrow_exception(errors[nused]);
+      }
+      nused++;
+      if (chunks[nused-1]->stopped) {
+         break;
+      }
+   }
+
+   // the main reader goes on where the section ends
+   const char* sectionend = chunks[nused-1]->stopped ? data + chunks[nused-1]->stopposition : inputend;
+
+   // the work of all chunks counts, the tokens of those that are used
+   Clock::time_point mergestart = now();
+   for (size_t c=0; c<chunkstats.size(); c++) {
+      const ParseStats& chunk = chunkstats[c];
+      stats->tokenizetime += chunk.tokenizetime;
+      stats->processtokenstime += chunk.processtokenstime;
+      stats->splittokenstime += chunk.splittokenstime;
+      stats->consectime += chunk.consectime;
+      stats->tokenmemory += chunk.tokenmemory;
+      stats->events.insert(stats->events.end(), chunk.events.begin(), chunk.events.end());
+      if (c < nused) {
+         nrawtokens += chunk.rawtokens;
+      }
+   }
+
+   // number the new variables, in order
+   std::vector<std::vector<uint32_t>> columns(nused);
+   for (size_t c=0; c<nused; c++) {
+      const SymbolTable& variables = chunks[c]->builder.variables;
+      columns[c].resize(variables.size());
+      for (uint32_t var=0; var<variables.size(); var++) {
+         columns[c][var] = builder.getvarid(variables.name(var), variables.length(var));
+      }
+   }
+
+   // where the rows of each chunk go
+   CompactModel& model = builder.model;
+   std::vector<size_t> rowoffset(nused + 1, model.nrows());
+   std::vector<size_t> nnzoffset(nused + 1, model.nnz());
+   std::vector<size_t> nameoffset(nused + 1, model.rownames.size());
+   std::vector<size_t> quadoffset(nused + 1, model.quadrows.size());
+   for (size_t c=0; c<nused; c++) {
+      const CompactModel& rows = chunks[c]->builder.model;
+      rowoffset[c+1] = rowoffset[c] + rows.nrows();
+      nnzoffset[c+1] = nnzoffset[c] + rows.nnz();
+      nameoffset[c+1] = nameoffset[c] + rows.rownames.size();
+      quadoffset[c+1] = quadoffset[c] + rows.quadrows.size();
+      nsectiontokens[(int)LpSectionKeyword::CON] += chunks[c]->nsectiontokens[(int)LpSectionKeyword::CON];
+   }
+   model.rowlower.resize(rowoffset[nused]);
+   model.rowupper.resize(rowoffset[nused]);
+   model.rowoffset.resize(rowoffset[nused]);
+   model.rowstart.resize(rowoffset[nused] + 1);
+   model.colindex.resize(nnzoffset[nused]);
+   model.value.resize(nnzoffset[nused]);
+   model.rownames.resize(nameoffset[nused]);
+   model.rownamestart.resize(rowoffset[nused] + 1);
+   model.quadrows.resize(quadoffset[nused]);
+   model.rowhessians.resize(quadoffset[nused]);
+
+   runparallel((unsigned int)nused, [&](unsigned int c) {
+      CompactModel& rows = chunks[c]->builder.model;
+      std::copy(rows.rowlower.begin(), rows.rowlower.end(), model.rowlower.begin() + rowoffset[c]);
+      std::copy(rows.rowupper.begin(), rows.rowupper.end(), model.rowupper.begin() + rowoffset[c]);
+      std::copy(rows.rowoffset.begin(), rows.rowoffset.end(), model.rowoffset.begin() + rowoffset[c]);
+      for (uint32_t row=0; row<rows.nrows(); row++) {
+         model.rowstart[rowoffset[c] + row + 1] = nnzoffset[c] + rows.rowstart[row + 1];
+         model.rownamestart[rowoffset[c] + row + 1] = nameoffset[c] + rows.rownamestart[row + 1];
+      }
+      for (size_t k=0; k<rows.nnz(); k++) {
+         model.colindex[nnzoffset[c] + k] = columns[c][rows.colindex[k]];
+      }
+      std::copy(rows.value.begin(), rows.value.end(), model.value.begin() + nnzoffset[c]);
+      std::copy(rows.rownames.begin(), rows.rownames.end(), model.rownames.begin() + nameoffset[c]);
+      for (size_t q=0; q<rows.quadrows.size(); q++) {
+         model.quadrows[quadoffset[c] + q] = (uint32_t)rowoffset[c] + rows.quadrows[q];
+         model.rowhessians[quadoffset[c] + q] = remaphessian(rows.rowhessians[q], columns[c]);
+      }
+      // free the chunk early
+      chunks[c].reset();
+   });
+   if (stats != nullptr) {
+      Clock::time_point end = Clock::now();
+      stats->mergetime += elapsed(mergestart, end);
+      paralleltime += elapsed(parallelstart, end);
+      addevent(stats, "merge chunks", thread, origin, mergestart, end);
+   }
+
+   inputpos = sectionend;
+   rawtokens.clear();
 }
 
 void Reader::processnonesec() {
-   lpassert(sectiontokens[LpSectionKeyword::NONE].empty());
+   lpassert(sectiontokens.empty());
 }
 
-void Reader::parseexpression(std::vector<std::unique_ptr<ProcessedToken>>& tokens, std::shared_ptr<Expression> expr, unsigned int& i) {
-   if (tokens.size() - i >= 1 && tokens[0]->type == ProcessedTokenType::CONID) {
-      expr->name = ((ProcessedConsIdToken*)tokens[i].get())->name;
+void Reader::parseexpression(std::vector<ProcessedToken>& tokens, unsigned int& i) {
+   if (tokens.size() - i >= 1 && tokens[i].type == ProcessedTokenType::CONID) {
+      builder.exprname = tokenstring(tokens[i]);
       i++;
    }
 
    while (i<tokens.size()) {
       // const var
       if (tokens.size() - i >= 2
-      && tokens[i]->type == ProcessedTokenType::CONST
-      && tokens[i+1]->type == ProcessedTokenType::VARID) {
-         std::string name = ((ProcessedVarIdToken*)tokens[i+1].get())->name;
-         
-         std::shared_ptr<LinTerm> linterm = std::shared_ptr<LinTerm>(new LinTerm());
-         linterm->coef = ((ProcessedConstantToken*)tokens[i].get())->value;
-         linterm->var = builder.getvarbyname(name);
-         expr->linterms.push_back(linterm);
+      && tokens[i].type == ProcessedTokenType::CONST
+      && tokens[i+1].type == ProcessedTokenType::VARID) {
+         builder.addlinterm(getvarid(tokens[i+1]), tokens[i].value);
 
          i += 2;
          continue;
       }
 
       // const
-      if (tokens.size() - i  >= 1 && tokens[i]->type == ProcessedTokenType::CONST) {
-         expr->offset = ((ProcessedConstantToken*)tokens[i].get())->value;
+      if (tokens.size() - i  >= 1 && tokens[i].type == ProcessedTokenType::CONST) {
+         builder.exproffset = tokens[i].value;
          i++;
          continue;
       }
       
       // var
-      if (tokens.size() - i  >= 1 && tokens[i]->type == ProcessedTokenType::VARID) {
-         std::string name = ((ProcessedVarIdToken*)tokens[i].get())->name;
-         
-         std::shared_ptr<LinTerm> linterm = std::shared_ptr<LinTerm>(new LinTerm());
-         linterm->coef = 1.0;
-         linterm->var = builder.getvarbyname(name);
-         expr->linterms.push_back(linterm);
+      if (tokens.size() - i  >= 1 && tokens[i].type == ProcessedTokenType::VARID) {
+         builder.addlinterm(getvarid(tokens[i]), 1.0);
 
          i++;
          continue;
       }
 
       // quadratic expression
-      if (tokens.size() - i >= 2 && tokens[i]->type == ProcessedTokenType::BRKOP) {
+      if (tokens.size() - i >= 2 && tokens[i].type == ProcessedTokenType::BRKOP) {
          i++;
-         while (i < tokens.size() && tokens[i]->type != ProcessedTokenType::BRKCL) {
+         while (i < tokens.size() && tokens[i].type != ProcessedTokenType::BRKCL) {
             // const var hat const
             if (tokens.size() - i >= 4
-            && tokens[i]->type == ProcessedTokenType::CONST
-            && tokens[i+1]->type == ProcessedTokenType::VARID
-            && tokens[i+2]->type == ProcessedTokenType::HAT
-            && tokens[i+3]->type == ProcessedTokenType::CONST) {
-               std::string name = ((ProcessedVarIdToken*)tokens[i+1].get())->name;
-
-               lpassert (((ProcessedConstantToken*)tokens[i+3].get())->value == 2.0);
+            && tokens[i].type == ProcessedTokenType::CONST
+            && tokens[i+1].type == ProcessedTokenType::VARID
+            && tokens[i+2].type == ProcessedTokenType::HAT
+            && tokens[i+3].type == ProcessedTokenType::CONST) {
+               lpassert (tokens[i+3].value == 2.0);
 
-               std::shared_ptr<QuadTerm> quadterm = std::shared_ptr<QuadTerm>(new QuadTerm());
-               quadterm->coef = ((ProcessedConstantToken*)tokens[i].get())->value;
-               quadterm->var1 = builder.getvarbyname(name);
-               quadterm->var2 = builder.getvarbyname(name);
-               expr->quadterms.push_back(quadterm);
+               uint32_t var = getvarid(tokens[i+1]);
+               builder.addquadterm(var, var, tokens[i].value);
 
                i += 4;
                continue;
@@ -308,18 +1304,13 @@ void Reader::parseexpression(std::vector<std::unique_ptr<ProcessedToken>>& token
 
             // var hat const
             if (tokens.size() - i >= 3
-            && tokens[i]->type == ProcessedTokenType::VARID
-            && tokens[i+1]->type == ProcessedTokenType::HAT
-            && tokens[i+2]->type == ProcessedTokenType::CONST) {
-               std::string name = ((ProcessedVarIdToken*)tokens[i].get())->name;
-
-               lpassert (((ProcessedConstantToken*)tokens[i+2].get())->value == 2.0);
+            && tokens[i].type == ProcessedTokenType::VARID
+            && tokens[i+1].type == ProcessedTokenType::HAT
+            && tokens[i+2].type == ProcessedTokenType::CONST) {
+               lpassert (tokens[i+2].value == 2.0);
 
-               std::shared_ptr<QuadTerm> quadterm = std::shared_ptr<QuadTerm>(new QuadTerm());
-               quadterm->coef = 1.0;
-               quadterm->var1 = builder.getvarbyname(name);
-               quadterm->var2 = builder.getvarbyname(name);
-               expr->quadterms.push_back(quadterm);
+               uint32_t var = getvarid(tokens[i]);
+               builder.addquadterm(var, var, 1.0);
 
                i += 3;
                continue;
@@ -327,18 +1318,14 @@ void Reader::parseexpression(std::vector<std::unique_ptr<ProcessedToken>>& token
 
             // const var asterisk var
             if (tokens.size() - i >= 4
-            && tokens[i]->type == ProcessedTokenType::CONST
-            && tokens[i+1]->type == ProcessedTokenType::VARID
-            && tokens[i+2]->type == ProcessedTokenType::ASTERISK
-            && tokens[i+3]->type == ProcessedTokenType::VARID) {
-               std::string name1 = ((ProcessedVarIdToken*)tokens[i+1].get())->name;
-               std::string name2 = ((ProcessedVarIdToken*)tokens[i+3].get())->name;
-
-               std::shared_ptr<QuadTerm> quadterm = std::shared_ptr<QuadTerm>(new QuadTerm());
-               quadterm->coef = ((ProcessedConstantToken*)tokens[i].get())->value;
-               quadterm->var1 = builder.getvarbyname(name1);
-               quadterm->var2 = builder.getvarbyname(name2);
-               expr->quadterms.push_back(quadterm);
+            && tokens[i].type == ProcessedTokenType::CONST
+            && tokens[i+1].type == ProcessedTokenType::VARID
+            && tokens[i+2].type == ProcessedTokenType::ASTERISK
+            && tokens[i+3].type == ProcessedTokenType::VARID) {
+               // variables are numbered in order of appearance
+               uint32_t var1 = getvarid(tokens[i+1]);
+               uint32_t var2 = getvarid(tokens[i+3]);
+               builder.addquadterm(var1, var2, tokens[i].value);
 
                i += 4;
                continue;
@@ -346,27 +1333,22 @@ void Reader::parseexpression(std::vector<std::unique_ptr<ProcessedToken>>& token
 
             // var asterisk var
             if (tokens.size() - i >= 3
-            && tokens[i]->type == ProcessedTokenType::VARID
-            && tokens[i+1]->type == ProcessedTokenType::ASTERISK
-            && tokens[i+2]->type == ProcessedTokenType::VARID) {
-               std::string name1 = ((ProcessedVarIdToken*)tokens[i].get())->name;
-               std::string name2 = ((ProcessedVarIdToken*)tokens[i+2].get())->name;
-
-               std::shared_ptr<QuadTerm> quadterm = std::shared_ptr<QuadTerm>(new QuadTerm());
-               quadterm->coef = 1.0;
-               quadterm->var1 = builder.getvarbyname(name1);
-               quadterm->var2 = builder.getvarbyname(name2);
-               expr->quadterms.push_back(quadterm);
+            && tokens[i].type == ProcessedTokenType::VARID
+            && tokens[i+1].type == ProcessedTokenType::ASTERISK
+            && tokens[i+2].type == ProcessedTokenType::VARID) {
+               uint32_t var1 = getvarid(tokens[i]);
+               uint32_t var2 = getvarid(tokens[i+2]);
+               builder.addquadterm(var1, var2, 1.0);
 
                i += 3;
                continue;
             }
          }
          lpassert(tokens.size() - i >= 3);
-         lpassert(tokens[i]->type == ProcessedTokenType::BRKCL);
-         lpassert(tokens[i+1]->type == ProcessedTokenType::SLASH);
-         lpassert(tokens[i+2]->type == ProcessedTokenType::CONST);
-         lpassert(((ProcessedConstantToken*)tokens[i+2].get())->value == 2.0);
+         lpassert(tokens[i].type == ProcessedTokenType::BRKCL);
+         lpassert(tokens[i+1].type == ProcessedTokenType::SLASH);
+         lpassert(tokens[i+2].type == ProcessedTokenType::CONST);
+         lpassert(tokens[i+2].value == 2.0);
          i += 3;
          continue;
       }
@@ -375,99 +1357,169 @@ void Reader::parseexpression(std::vector<std::unique_ptr<ProcessedToken>>& token
    }
 }
 
-void Reader::processobjsec() {
-   builder.model.objective = std::shared_ptr<Expression>(new Expression);
-   unsigned int i = 0;   
-   parseexpression(sectiontokens[LpSectionKeyword::OBJ], builder.model.objective, i);
-   lpassert(i == sectiontokens[LpSectionKeyword::OBJ].size());
+void Reader::processobjsec(bool final) {
+   // the objective is a single expression without terminator
+   if (!final) {
+      return;
+   }
+   unsigned int i = 0;
+   parseexpression(sectiontokens, i);
+   lpassert(i == sectiontokens.size());
+   builder.setobjective();
+   sectiontokens.clear();
 }
 
-void Reader::processconsec() {
+// the index of the comparison after the first bound of a ranged row starting
+// at tokens[i], as in "c1: 2 <= x + y <= 5", or 0 if the row is not ranged
+unsigned int rangedrowcomparison(const std::vector<ProcessedToken>& tokens, unsigned int i) {
+   if (tokens[i].type == ProcessedTokenType::CONID) {
+      i++;
+   }
+   if (tokens.size() - i >= 2 && tokens[i].type == ProcessedTokenType::CONST && tokens[i+1].type == ProcessedTokenType::COMP) {
+      return i + 1;
+   }
+   return 0;
+}
+
+// the index of the comparison or row name that ends the expression starting
+// at tokens[i], or the number of tokens if neither follows yet
+unsigned int expressionend(const std::vector<ProcessedToken>& tokens, unsigned int i) {
+   while (i < tokens.size() && tokens[i].type != ProcessedTokenType::COMP && tokens[i].type != ProcessedTokenType::CONID) {
+      i++;
+   }
+   return i;
+}
+
+void Reader::processconsec(bool final) {
+   // a constraint is complete as soon as the right hand side follows the
+   // comparison, unless that is the first bound of a ranged row
+   unsigned int n = sectiontokens.size();
+   if (!final && !(n >= 2 && sectiontokens[n-2].type == ProcessedTokenType::COMP && sectiontokens[n-1].type == ProcessedTokenType::CONST
+   && rangedrowcomparison(sectiontokens, 0) != n - 2)) {
+      return;
+   }
+
    unsigned int i=0;
-   while (i<sectiontokens[LpSectionKeyword::CON].size()) {
-      std::shared_ptr<Constraint> con = std::shared_ptr<Constraint>(new Constraint);
-      parseexpression(sectiontokens[LpSectionKeyword::CON], con->expr, i);
-      lpassert(sectiontokens[LpSectionKeyword::CON].size() - i >= 2);
-	  lpassert(sectiontokens[LpSectionKeyword::CON][i]->type == ProcessedTokenType::COMP);
-      lpassert(sectiontokens[LpSectionKeyword::CON][i+1]->type == ProcessedTokenType::CONST);
-      double value = ((ProcessedConstantToken*)sectiontokens[LpSectionKeyword::CON][i+1].get())->value;
-      switch (((ProcessedComparisonToken*)sectiontokens[LpSectionKeyword::CON][i].get())->dir) {
-         case LpComparisonType::EQ:
-            con->lowerbound = con->upperbound = value;
-            break;
-         case LpComparisonType::LEQ:
-            con->upperbound = value;
-            break;
-         case LpComparisonType::GEQ:
-            con->lowerbound = value;
+   while (i<sectiontokens.size()) {
+      // first bound of a ranged row, unless no second comparison follows the
+      // expression, as in "c1: 0 <= 5"
+      unsigned int rangecomparison = rangedrowcomparison(sectiontokens, i);
+      if (rangecomparison != 0) {
+         unsigned int end = expressionend(sectiontokens, rangecomparison + 1);
+         if (end == sectiontokens.size() && !final) {
+            // the next tokens decide, keep the row until they are seen
             break;
-         default:
-            lpassert(false);
+         }
+         if (end == sectiontokens.size() || sectiontokens[end].type != ProcessedTokenType::COMP) {
+            rangecomparison = 0;
+         }
+      }
+      if (rangecomparison != 0) {
+         if (sectiontokens[i].type == ProcessedTokenType::CONID) {
+            builder.exprname = tokenstring(sectiontokens[i]);
+         }
+         i = rangecomparison + 1;
+      }
+
+      parseexpression(sectiontokens, i);
+      lpassert(sectiontokens.size() - i >= 2);
+	  lpassert(sectiontokens[i].type == ProcessedTokenType::COMP);
+      lpassert(sectiontokens[i+1].type == ProcessedTokenType::CONST);
+      double value = sectiontokens[i+1].value;
+      double lowerbound = -std::numeric_limits<double>::infinity();
+      double upperbound = std::numeric_limits<double>::infinity();
+      if (rangecomparison != 0) {
+         // lower <= expression <= upper or upper >= expression >= lower
+         double rangevalue = sectiontokens[rangecomparison-1].value;
+         LpComparisonType dir = sectiontokens[rangecomparison].dir;
+         lpassert(sectiontokens[i].dir == dir);
+         switch (dir) {
+            case LpComparisonType::LEQ:
+               lowerbound = rangevalue;
+               upperbound = value;
+               break;
+            case LpComparisonType::GEQ:
+               lowerbound = value;
+               upperbound = rangevalue;
+               break;
+            default:
+               lpassert(false);
+         }
+      } else {
+         switch (sectiontokens[i].dir) {
+            case LpComparisonType::EQ:
+               lowerbound = upperbound = value;
+               break;
+            case LpComparisonType::LEQ:
+               upperbound = value;
+               break;
+            case LpComparisonType::GEQ:
+               lowerbound = value;
+               break;
+            default:
+               lpassert(false);
+         }
       }
       i += 2;
-      builder.model.constraints.push_back(con);
+      builder.addconstraint(lowerbound, upperbound);
    }
+   sectiontokens.erase(sectiontokens.begin(), sectiontokens.begin() + i);
 }
 
-void Reader::processboundssec() {
+void Reader::processboundssec(bool final) {
    unsigned int i=0;
-   while (i<sectiontokens[LpSectionKeyword::BOUNDS].size()) {
+   while (i<sectiontokens.size() && (final || sectiontokens.size() - i >= LP_MAX_BOUND_LENGTH)) {
       // VAR free
-      if (sectiontokens[LpSectionKeyword::BOUNDS].size() - i >= 2
-         && sectiontokens[LpSectionKeyword::BOUNDS][i]->type == ProcessedTokenType::VARID
-         && sectiontokens[LpSectionKeyword::BOUNDS][i+1]->type == ProcessedTokenType::FREE) {
-         std::string name = ((ProcessedVarIdToken*)sectiontokens[LpSectionKeyword::BOUNDS][i].get())->name;
-         std::shared_ptr<Variable> var = builder.getvarbyname(name);
-         var->lowerbound = -std::numeric_limits<double>::infinity(); 
-         var->upperbound = std::numeric_limits<double>::infinity();
+      if (sectiontokens.size() - i >= 2
+         && sectiontokens[i].type == ProcessedTokenType::VARID
+         && sectiontokens[i+1].type == ProcessedTokenType::FREE) {
+         uint32_t var = getvarid(sectiontokens[i]);
+         builder.setbounds(var, -std::numeric_limits<double>::infinity(), std::numeric_limits<double>::infinity());
          i += 2;
 		 continue;
       }
 
 	  // CONST COMP VAR COMP CONST
-	  if (sectiontokens[LpSectionKeyword::BOUNDS].size() - i >= 5
-		  && sectiontokens[LpSectionKeyword::BOUNDS][i]->type == ProcessedTokenType::CONST
-		  && sectiontokens[LpSectionKeyword::BOUNDS][i + 1]->type == ProcessedTokenType::COMP
-		  && sectiontokens[LpSectionKeyword::BOUNDS][i + 2]->type == ProcessedTokenType::VARID
-		  && sectiontokens[LpSectionKeyword::BOUNDS][i + 3]->type == ProcessedTokenType::COMP
-		  && sectiontokens[LpSectionKeyword::BOUNDS][i + 4]->type == ProcessedTokenType::CONST) {
-		  lpassert(((ProcessedComparisonToken*)sectiontokens[LpSectionKeyword::BOUNDS][i + 1].get())->dir == LpComparisonType::LEQ);
-		  lpassert(((ProcessedComparisonToken*)sectiontokens[LpSectionKeyword::BOUNDS][i + 3].get())->dir == LpComparisonType::LEQ);
+	  if (sectiontokens.size() - i >= 5
+		  && sectiontokens[i].type == ProcessedTokenType::CONST
+		  && sectiontokens[i + 1].type == ProcessedTokenType::COMP
+		  && sectiontokens[i + 2].type == ProcessedTokenType::VARID
+		  && sectiontokens[i + 3].type == ProcessedTokenType::COMP
+		  && sectiontokens[i + 4].type == ProcessedTokenType::CONST) {
+		  lpassert(sectiontokens[i + 1].dir == LpComparisonType::LEQ);
+		  lpassert(sectiontokens[i + 3].dir == LpComparisonType::LEQ);
 
-		  double lb = ((ProcessedConstantToken*)sectiontokens[LpSectionKeyword::BOUNDS][i].get())->value;
-		  double ub = ((ProcessedConstantToken*)sectiontokens[LpSectionKeyword::BOUNDS][i + 4].get())->value;
+		  double lb = sectiontokens[i].value;
+		  double ub = sectiontokens[i + 4].value;
 
-		  std::string name = ((ProcessedVarIdToken*)sectiontokens[LpSectionKeyword::BOUNDS][i + 2].get())->name;
-		  std::shared_ptr<Variable> var = builder.getvarbyname(name);
+		  uint32_t var = getvarid(sectiontokens[i + 2]);
 
-		  var->lowerbound = lb;
-		  var->upperbound = ub;
+		  builder.setbounds(var, lb, ub);
 
 		  i += 5;
 		  continue;
 	  }
 
       // CONST COMP VAR
-      if (sectiontokens[LpSectionKeyword::BOUNDS].size() - i >= 3
-      && sectiontokens[LpSectionKeyword::BOUNDS][i]->type == ProcessedTokenType::CONST
-      && sectiontokens[LpSectionKeyword::BOUNDS][i+1]->type == ProcessedTokenType::COMP
-      && sectiontokens[LpSectionKeyword::BOUNDS][i+2]->type == ProcessedTokenType::VARID) {
-         double value = ((ProcessedConstantToken*)sectiontokens[LpSectionKeyword::BOUNDS][i].get())->value;
-         std::string name = ((ProcessedVarIdToken*)sectiontokens[LpSectionKeyword::BOUNDS][i+2].get())->name;
-         std::shared_ptr<Variable> var = builder.getvarbyname(name);
-         LpComparisonType dir = ((ProcessedComparisonToken*)sectiontokens[LpSectionKeyword::BOUNDS][i+1].get())->dir;
+      if (sectiontokens.size() - i >= 3
+      && sectiontokens[i].type == ProcessedTokenType::CONST
+      && sectiontokens[i+1].type == ProcessedTokenType::COMP
+      && sectiontokens[i+2].type == ProcessedTokenType::VARID) {
+         double value = sectiontokens[i].value;
+         uint32_t var = getvarid(sectiontokens[i+2]);
+         LpComparisonType dir = sectiontokens[i+1].dir;
 
          lpassert(dir != LpComparisonType::L && dir != LpComparisonType::G);
 
          switch (dir) {
             case LpComparisonType::LEQ:
-               var->lowerbound = value;
+               builder.setbounds(var, value, builder.model.colupper[var]);
                break;
             case LpComparisonType::GEQ:
-               var->upperbound = value;
+               builder.setbounds(var, builder.model.collower[var], value);
                break;
             case LpComparisonType::EQ:
-               var->lowerbound = var->upperbound = value;
+               builder.setbounds(var, value, value);
                break;
             default:
                lpassert(false);
@@ -477,26 +1529,25 @@ void Reader::processboundssec() {
       }
 
       // VAR COMP CONST
-      if (sectiontokens[LpSectionKeyword::BOUNDS].size() -i >= 3
-      && sectiontokens[LpSectionKeyword::BOUNDS][i]->type == ProcessedTokenType::VARID
-      && sectiontokens[LpSectionKeyword::BOUNDS][i+1]->type == ProcessedTokenType::COMP
-      && sectiontokens[LpSectionKeyword::BOUNDS][i+2]->type == ProcessedTokenType::CONST) {
-         double value = ((ProcessedConstantToken*)sectiontokens[LpSectionKeyword::BOUNDS][i+2].get())->value;
-         std::string name = ((ProcessedVarIdToken*)sectiontokens[LpSectionKeyword::BOUNDS][i].get())->name;
-         std::shared_ptr<Variable> var = builder.getvarbyname(name);
-         LpComparisonType dir = ((ProcessedComparisonToken*)sectiontokens[LpSectionKeyword::BOUNDS][i+1].get())->dir;
+      if (sectiontokens.size() -i >= 3
+      && sectiontokens[i].type == ProcessedTokenType::VARID
+      && sectiontokens[i+1].type == ProcessedTokenType::COMP
+      && sectiontokens[i+2].type == ProcessedTokenType::CONST) {
+         double value = sectiontokens[i+2].value;
+         uint32_t var = getvarid(sectiontokens[i]);
+         LpComparisonType dir = sectiontokens[i+1].dir;
 
          lpassert(dir != LpComparisonType::L && dir != LpComparisonType::G);
 
          switch (dir) {
             case LpComparisonType::LEQ:
-               var->upperbound = value;
+               builder.setbounds(var, builder.model.collower[var], value);
                break;
             case LpComparisonType::GEQ:
-               var->lowerbound = value;
+               builder.setbounds(var, value, builder.model.colupper[var]);
                break;
             case LpComparisonType::EQ:
-               var->lowerbound = var->upperbound = value;
+               builder.setbounds(var, value, value);
                break;
             default:
                lpassert(false);
@@ -507,269 +1558,359 @@ void Reader::processboundssec() {
       
 	  lpassert(false);
    }
+   sectiontokens.erase(sectiontokens.begin(), sectiontokens.begin() + i);
 }
 
 void Reader::processbinsec() {
-   for (unsigned int i=0; i<sectiontokens[LpSectionKeyword::BIN].size(); i++) {
-      lpassert(sectiontokens[LpSectionKeyword::BIN][i]->type == ProcessedTokenType::VARID);
-      std::string name = ((ProcessedVarIdToken*)sectiontokens[LpSectionKeyword::BIN][i].get())->name;
-      std::shared_ptr<Variable> var = builder.getvarbyname(name);
-      var->type = VariableType::BINARY;
+   for (unsigned int i=0; i<sectiontokens.size(); i++) {
+      lpassert(sectiontokens[i].type == ProcessedTokenType::VARID);
+      uint32_t var = getvarid(sectiontokens[i]);
+      builder.settype(var, VariableType::BINARY);
    }
+   sectiontokens.clear();
 }
 
 void Reader::processgensec() {
-   for (unsigned int i=0; i<sectiontokens[LpSectionKeyword::GEN].size(); i++) {
-      lpassert(sectiontokens[LpSectionKeyword::GEN][i]->type == ProcessedTokenType::VARID);
-      std::string name = ((ProcessedVarIdToken*)sectiontokens[LpSectionKeyword::GEN][i].get())->name;
-      std::shared_ptr<Variable> var = builder.getvarbyname(name);
-      var->type = VariableType::GENERAL;
+   for (unsigned int i=0; i<sectiontokens.size(); i++) {
+      lpassert(sectiontokens[i].type == ProcessedTokenType::VARID);
+      uint32_t var = getvarid(sectiontokens[i]);
+      builder.settype(var, VariableType::GENERAL);
    }
+   sectiontokens.clear();
 }
 
 void Reader::processsemisec() {
-   for (unsigned int i=0; i<sectiontokens[LpSectionKeyword::SEMI].size(); i++) {
-      lpassert(sectiontokens[LpSectionKeyword::SEMI][i]->type == ProcessedTokenType::VARID);
-      std::string name = ((ProcessedVarIdToken*)sectiontokens[LpSectionKeyword::SEMI][i].get())->name;
-      std::shared_ptr<Variable> var = builder.getvarbyname(name);
-      var->type = VariableType::SEMICONTINUOUS;
+   for (unsigned int i=0; i<sectiontokens.size(); i++) {
+      lpassert(sectiontokens[i].type == ProcessedTokenType::VARID);
+      uint32_t var = getvarid(sectiontokens[i]);
+      builder.settype(var, VariableType::SEMICONTINUOUS);
    }
+   sectiontokens.clear();
 }
 
 void Reader::processsossec() {
    // TODO
-   lpassert(sectiontokens[LpSectionKeyword::SOS].empty());
+   lpassert(sectiontokens.empty());
 }
 
 void Reader::processendsec() {
-   lpassert(sectiontokens[LpSectionKeyword::END].empty());
+   lpassert(sectiontokens.empty());
 }
 
-void Reader::processsections() {
-   processnonesec();
-   processobjsec();
-   processconsec();
-   processboundssec();
-   processgensec();
-   processbinsec();
-   processsemisec();
-   processsossec();
-   processendsec();
+void Reader::processsection(bool final) {
+   PhaseTimer timer(sectionphase(final), phasestack);
+   switch (currentsection) {
+      case LpSectionKeyword::NONE:
+         processnonesec();
+         break;
+      case LpSectionKeyword::OBJ:
+         processobjsec(final);
+         break;
+      case LpSectionKeyword::CON:
+         processconsec(final);
+         break;
+      case LpSectionKeyword::BOUNDS:
+         processboundssec(final);
+         break;
+      case LpSectionKeyword::GEN:
+         processgensec();
+         break;
+      case LpSectionKeyword::BIN:
+         processbinsec();
+         break;
+      case LpSectionKeyword::SEMI:
+         processsemisec();
+         break;
+      case LpSectionKeyword::SOS:
+         processsossec();
+         break;
+      case LpSectionKeyword::END:
+         processendsec();
+         break;
+   }
 }
 
-void Reader::splittokens() {
-   LpSectionKeyword currentsection = LpSectionKeyword::NONE;
-   
-   for (unsigned int i=0; i < processedtokens.size(); ++i) {
-      if (processedtokens[i]->type == ProcessedTokenType::SECID) {
-         currentsection = ((ProcessedTokenSectionKeyword*)processedtokens[i].get())->keyword;
-         
-         if (currentsection == LpSectionKeyword::OBJ) {
-            switch(((ProcessedTokenObjectiveSectionKeyword*)processedtokens[i].get())->objsense) {
-               case LpObjectiveSectionKeywordType::MIN:
-                  builder.model.sense = ObjectiveSense::MIN;
-                  break;
-               case LpObjectiveSectionKeywordType::MAX:
-                  builder.model.sense = ObjectiveSense::MAX;
-                  break;
-               default:
-                  lpassert(false);
-            }
+// whether a section has to wait, as one that comes before it in the order
+// of LpSectionKeyword may still follow in the file or waits itself
+bool Reader::mustdefer(LpSectionKeyword section) const {
+   if (section == LpSectionKeyword::NONE || section == LpSectionKeyword::END) {
+      return false;
+   }
+   for (int s=(int)LpSectionKeyword::OBJ; s<(int)section; s++) {
+      if (!seen[s] || deferred[s]) {
+         return true;
+      }
+   }
+   return false;
+}
+
+void Reader::endsection() {
+   if (deferred[(int)currentsection]) {
+      deferredtokens[(int)currentsection] = std::move(sectiontokens);
+      sectiontokens.clear();
+   } else {
+      processsection(true);
+   }
+}
+
+// the sections that waited, in order, once all of the input has been read
+void Reader::processdeferred() {
+   for (int s=(int)LpSectionKeyword::OBJ; s<(int)LpSectionKeyword::END; s++) {
+      if (!deferred[s]) {
+         continue;
+      }
+      currentsection = (LpSectionKeyword)s;
+      sectiontokens.swap(deferredtokens[s]);
+      deferredtokens[s] = std::vector<ProcessedToken>();
+      processsection(true);
+      endsectionevent(now());
+   }
+}
+
+void Reader::splittoken(const ProcessedToken& token) {
+   PhaseTimer timer(phase(&ParseStats::splittokenstime), phasestack);
+   if (token.type == ProcessedTokenType::SECID) {
+      // the previous section ends here
+      if (ischunk) {
+         processsection(true);
+         stopped = true;
+         stopposition = token.position;
+         return;
+      }
+      endsection();
+      endsectionevent(now());
+
+      currentsection = token.keyword;
+      
+      if (currentsection == LpSectionKeyword::OBJ) {
+         switch(token.objsense) {
+            case LpObjectiveSectionKeywordType::MIN:
+               builder.setsense(ObjectiveSense::MIN);
+               break;
+            case LpObjectiveSectionKeywordType::MAX:
+               builder.setsense(ObjectiveSense::MAX);
+               break;
+            default:
+               lpassert(false);
          }
+      }
 
-         // make sure this section did not yet occur
-         lpassert(sectiontokens[currentsection].empty());
-      } else {
-         sectiontokens[currentsection].push_back(std::move(processedtokens[i]));
+      // make sure this section did not yet occur
+      lpassert(nsectiontokens[(int)currentsection] == 0);
+      deferred[(int)currentsection] = mustdefer(currentsection);
+      seen[(int)currentsection] = true;
+   } else {
+      nsectiontokens[(int)currentsection]++;
+      sectiontokens.push_back(token);
+      if (!deferred[(int)currentsection]) {
+         processsection(false);
       }
    }
 }
 
-void Reader::processtokens() {
+void Reader::processtokens(bool final) {
+   PhaseTimer timer(phase(&ParseStats::processtokenstime), phasestack);
    unsigned int i = 0;
+   unsigned int start = 0;
    
-   while (i < this->rawtokens.size()) {
-      fflush(stdout);
+   // unless the input is exhausted, only process tokens with the full lookahead available
+   while (!stopped && i < this->rawtokens.size() && (final || this->rawtokens.size() - i >= LP_MAX_RAW_LOOKAHEAD)) {
+      start = i;
+      size_t position = rawtokens[i].position;
 
       // long section keyword semi-continuous
-      if (rawtokens.size() - i >= 3 && rawtokens[i]->istype(RawTokenType::STR) && rawtokens[i+1]->istype(RawTokenType::MINUS) && rawtokens[i+2]->istype(RawTokenType::STR)) {
-         std::string temp = ((RawStringToken*)rawtokens[i].get())->value + "-" + ((RawStringToken*)rawtokens[i+2].get())->value;
-         LpSectionKeyword keyword = parsesectionkeyword(temp);
+      if (rawtokens.size() - i >= 3 && rawtokens[i].istype(RawTokenType::STR) && rawtokens[i+1].istype(RawTokenType::MINUS) && rawtokens[i+2].istype(RawTokenType::STR)) {
+         LpSectionKeyword keyword = sectionkeyword(lexkeyword(data + rawtokens[i].position, rawtokens[i].length, '-', data + rawtokens[i+2].position, rawtokens[i+2].length));
          if (keyword != LpSectionKeyword::NONE) {
-            processedtokens.push_back(std::unique_ptr<ProcessedToken>(new ProcessedTokenSectionKeyword(keyword)));
+            splittoken(ProcessedTokenSectionKeyword(keyword, position));
             i += 3;
             continue;
          }
       }
 
       // long section keyword subject to/such that
-      if (rawtokens.size() - i >= 2 && rawtokens[i]->istype(RawTokenType::STR) && rawtokens[i+1]->istype(RawTokenType::STR)) {
-         std::string temp = ((RawStringToken*)rawtokens[i].get())->value + " " + ((RawStringToken*)rawtokens[i+1].get())->value;
-         LpSectionKeyword keyword = parsesectionkeyword(temp);
+      if (rawtokens.size() - i >= 2 && rawtokens[i].istype(RawTokenType::STR) && rawtokens[i+1].istype(RawTokenType::STR)) {
+         LpSectionKeyword keyword = sectionkeyword(lexkeyword(data + rawtokens[i].position, rawtokens[i].length, ' ', data + rawtokens[i+1].position, rawtokens[i+1].length));
          if (keyword != LpSectionKeyword::NONE) {
-            processedtokens.push_back(std::unique_ptr<ProcessedToken>(new ProcessedTokenSectionKeyword(keyword)));
+            splittoken(ProcessedTokenSectionKeyword(keyword, position));
             i += 2;
             continue;
          }
       }
 
+      LpKeyword keyword = rawtokens[i].istype(RawTokenType::STR) ? lexkeyword(data + position, rawtokens[i].length) : LpKeyword::NONE;
+
       // other section keyword
-      if (rawtokens[i]->istype(RawTokenType::STR)) {
-         LpSectionKeyword keyword = parsesectionkeyword(((RawStringToken*)rawtokens[i].get())->value);
-         if (keyword != LpSectionKeyword::NONE) {
-            if (keyword == LpSectionKeyword::OBJ) {
-               LpObjectiveSectionKeywordType kw = parseobjectivesectionkeyword(((RawStringToken*)rawtokens[i].get())->value);
-               processedtokens.push_back(std::unique_ptr<ProcessedToken>(new ProcessedTokenObjectiveSectionKeyword(kw)));
-            } else {
-               processedtokens.push_back(std::unique_ptr<ProcessedToken>(new ProcessedTokenSectionKeyword(keyword)));
-            }
-            i++;
-            continue;
+      if (sectionkeyword(keyword) != LpSectionKeyword::NONE) {
+         if (keyword == LpKeyword::MIN) {
+            splittoken(ProcessedTokenObjectiveSectionKeyword(LpObjectiveSectionKeywordType::MIN, position));
+         } else if (keyword == LpKeyword::MAX) {
+            splittoken(ProcessedTokenObjectiveSectionKeyword(LpObjectiveSectionKeywordType::MAX, position));
+         } else {
+            splittoken(ProcessedTokenSectionKeyword(sectionkeyword(keyword), position));
          }
+         i++;
+         continue;
       }
 
       // constraint identifier?
-      if (rawtokens.size() - i >= 2 && rawtokens[i]->istype(RawTokenType::STR) && rawtokens[i+1]->istype(RawTokenType::COLON)) {
-         processedtokens.push_back(std::unique_ptr<ProcessedToken>(new ProcessedConsIdToken(((RawStringToken*)rawtokens[i].get())->value)));
+      if (rawtokens.size() - i >= 2 && rawtokens[i].istype(RawTokenType::STR) && rawtokens[i+1].istype(RawTokenType::COLON)) {
+         splittoken(ProcessedConsIdToken(position, rawtokens[i].length));
          i += 2;
          continue;
       }
 
       // check if free
-      if (rawtokens[i]->istype(RawTokenType::STR) && iskeyword(((RawStringToken*)rawtokens[i].get())->value, LP_KEYWORD_FREE, LP_KEYWORD_FREE_N)) {
-         processedtokens.push_back(std::unique_ptr<ProcessedToken>(new ProcessedToken(ProcessedTokenType::FREE)));
+      if (keyword == LpKeyword::FREE) {
+         splittoken(ProcessedToken(ProcessedTokenType::FREE, position));
          i++;
          continue;
       }
 
       // check if infinty
-      if (rawtokens[i]->istype(RawTokenType::STR) && iskeyword(((RawStringToken*)rawtokens[i].get())->value, LP_KEYWORD_INF, LP_KEYWORD_INF_N)) {
-         processedtokens.push_back(std::unique_ptr<ProcessedToken>(new ProcessedConstantToken(std::numeric_limits<double>::infinity())));
+      if (keyword == LpKeyword::INF) {
+         splittoken(ProcessedConstantToken(std::numeric_limits<double>::infinity(), position));
          i++;
          continue;
       }
 
       // assume var identifier
-      if (rawtokens[i]->istype(RawTokenType::STR)) {
-         processedtokens.push_back(std::unique_ptr<ProcessedToken>(new ProcessedVarIdToken(((RawStringToken*)rawtokens[i].get())->value)));
+      if (rawtokens[i].istype(RawTokenType::STR)) {
+         splittoken(ProcessedVarIdToken(position, rawtokens[i].length));
          i++;
          continue;
       }
 
+      // + infinity
+      if (rawtokens.size() - i >= 2 && rawtokens[i].istype(RawTokenType::PLUS) && isinfinity(rawtokens[i+1])) {
+         splittoken(ProcessedConstantToken(std::numeric_limits<double>::infinity(), position));
+         i += 2;
+         continue;
+      }
+
+      // - infinity
+      if (rawtokens.size() - i >= 2 && rawtokens[i].istype(RawTokenType::MINUS) && isinfinity(rawtokens[i+1])) {
+         splittoken(ProcessedConstantToken(-std::numeric_limits<double>::infinity(), position));
+         i += 2;
+         continue;
+      }
+
       // + Constant
-      if (rawtokens.size() - i >= 2 && rawtokens[i]->istype(RawTokenType::PLUS) && rawtokens[i+1]->istype(RawTokenType::CONS)) {
-         processedtokens.push_back(std::unique_ptr<ProcessedToken>(new ProcessedConstantToken(((RawConstantToken*)rawtokens[i+1].get())->value)));
+      if (rawtokens.size() - i >= 2 && rawtokens[i].istype(RawTokenType::PLUS) && rawtokens[i+1].istype(RawTokenType::CONS)) {
+         splittoken(ProcessedConstantToken(rawtokens[i+1].value, position));
          i += 2;
          continue;
       }
 
       // - constant
-      if (rawtokens.size() - i >= 2 && rawtokens[i]->istype(RawTokenType::MINUS) && rawtokens[i+1]->istype(RawTokenType::CONS)) {
-         processedtokens.push_back(std::unique_ptr<ProcessedToken>(new ProcessedConstantToken(-((RawConstantToken*)rawtokens[i+1].get())->value)));
+      if (rawtokens.size() - i >= 2 && rawtokens[i].istype(RawTokenType::MINUS) && rawtokens[i+1].istype(RawTokenType::CONS)) {
+         splittoken(ProcessedConstantToken(-rawtokens[i+1].value, position));
          i += 2;
          continue;
       }
 
       // + [
-      if (rawtokens.size() - i >= 2 && rawtokens[i]->istype(RawTokenType::PLUS) &&rawtokens[i+1]->istype(RawTokenType::PLUS)) {
-         processedtokens.push_back(std::unique_ptr<ProcessedToken>(new ProcessedToken(ProcessedTokenType::BRKOP)));
+      if (rawtokens.size() - i >= 2 && rawtokens[i].istype(RawTokenType::PLUS) && rawtokens[i+1].istype(RawTokenType::BRKOP)) {
+         splittoken(ProcessedToken(ProcessedTokenType::BRKOP, position));
          i += 2;
          continue;
       }
 
       // +
-      if (rawtokens[i]->istype(RawTokenType::PLUS)) {
-         processedtokens.push_back(std::unique_ptr<ProcessedToken>(new ProcessedConstantToken(1.0)));
+      if (rawtokens[i].istype(RawTokenType::PLUS)) {
+         splittoken(ProcessedConstantToken(1.0, position));
          i++;
          continue;
       }
 
       // -
-      if (rawtokens[i]->istype(RawTokenType::MINUS)) {
-         processedtokens.push_back(std::unique_ptr<ProcessedToken>(new ProcessedConstantToken(-1.0)));
+      if (rawtokens[i].istype(RawTokenType::MINUS)) {
+         splittoken(ProcessedConstantToken(-1.0, position));
          i++;
          continue;
       }
 
       // constant
-      if (rawtokens[i]->istype(RawTokenType::CONS)) {
-         processedtokens.push_back(std::unique_ptr<ProcessedToken>(new ProcessedConstantToken(((RawConstantToken*)rawtokens[i].get())->value)));
+      if (rawtokens[i].istype(RawTokenType::CONS)) {
+         splittoken(ProcessedConstantToken(rawtokens[i].value, position));
          i++;
          continue;
       }
 
       // [
-      if (rawtokens[i]->istype(RawTokenType::BRKOP)) {
-         processedtokens.push_back(std::unique_ptr<ProcessedToken>(new ProcessedToken(ProcessedTokenType::BRKOP)));
+      if (rawtokens[i].istype(RawTokenType::BRKOP)) {
+         splittoken(ProcessedToken(ProcessedTokenType::BRKOP, position));
          i++;
          continue;
       }
 
       // ]
-      if (rawtokens[i]->istype(RawTokenType::BRKCL)) {
-         processedtokens.push_back(std::unique_ptr<ProcessedToken>(new ProcessedToken(ProcessedTokenType::BRKCL)));
+      if (rawtokens[i].istype(RawTokenType::BRKCL)) {
+         splittoken(ProcessedToken(ProcessedTokenType::BRKCL, position));
          i++;
          continue;
       }
 
       // /
-      if (rawtokens[i]->istype(RawTokenType::SLASH)) {
-         processedtokens.push_back(std::unique_ptr<ProcessedToken>(new ProcessedToken(ProcessedTokenType::SLASH)));
+      if (rawtokens[i].istype(RawTokenType::SLASH)) {
+         splittoken(ProcessedToken(ProcessedTokenType::SLASH, position));
          i++;
          continue;
       }
 
       // *
-      if (rawtokens[i]->istype(RawTokenType::ASTERISK)) {
-         processedtokens.push_back(std::unique_ptr<ProcessedToken>(new ProcessedToken(ProcessedTokenType::ASTERISK)));
+      if (rawtokens[i].istype(RawTokenType::ASTERISK)) {
+         splittoken(ProcessedToken(ProcessedTokenType::ASTERISK, position));
          i++;
          continue;
       }
 
       // ^
-      if (rawtokens[i]->istype(RawTokenType::HAT)) {
-         processedtokens.push_back(std::unique_ptr<ProcessedToken>(new ProcessedToken(ProcessedTokenType::HAT)));
+      if (rawtokens[i].istype(RawTokenType::HAT)) {
+         splittoken(ProcessedToken(ProcessedTokenType::HAT, position));
          i++;
          continue;
       }
 
       // <=
-      if (rawtokens.size() - i >= 2 && rawtokens[i]->istype(RawTokenType::LESS) && rawtokens[i+1]->istype(RawTokenType::EQUAL)) {
-         processedtokens.push_back(std::unique_ptr<ProcessedToken>(new ProcessedComparisonToken(LpComparisonType::LEQ)));
+      if (rawtokens.size() - i >= 2 && rawtokens[i].istype(RawTokenType::LESS) && rawtokens[i+1].istype(RawTokenType::EQUAL)) {
+         splittoken(ProcessedComparisonToken(LpComparisonType::LEQ, position));
          i += 2;
          continue;
       }
 
       // <
-      if (rawtokens[i]->istype(RawTokenType::LESS)) {
-         processedtokens.push_back(std::unique_ptr<ProcessedToken>(new ProcessedComparisonToken(LpComparisonType::L)));
+      if (rawtokens[i].istype(RawTokenType::LESS)) {
+         splittoken(ProcessedComparisonToken(LpComparisonType::L, position));
          i++;
          continue;
       }
 
       // >=
-      if (rawtokens.size() - i >= 2 && rawtokens[i]->istype(RawTokenType::GREATER) && rawtokens[i+1]->istype(RawTokenType::EQUAL)) {
-         processedtokens.push_back(std::unique_ptr<ProcessedToken>(new ProcessedComparisonToken(LpComparisonType::GEQ)));
+      if (rawtokens.size() - i >= 2 && rawtokens[i].istype(RawTokenType::GREATER) && rawtokens[i+1].istype(RawTokenType::EQUAL)) {
+         splittoken(ProcessedComparisonToken(LpComparisonType::GEQ, position));
          i += 2;
          continue;
       }
 
       // >
-      if (rawtokens[i]->istype(RawTokenType::GREATER)) {
-         processedtokens.push_back(std::unique_ptr<ProcessedToken>(new ProcessedComparisonToken(LpComparisonType::G)));
+      if (rawtokens[i].istype(RawTokenType::GREATER)) {
+         splittoken(ProcessedComparisonToken(LpComparisonType::G, position));
          i++;
          continue;
       }
 
       // =
-      if (rawtokens[i]->istype(RawTokenType::EQUAL)) {
-         processedtokens.push_back(std::unique_ptr<ProcessedToken>(new ProcessedComparisonToken(LpComparisonType::EQ)));
+      if (rawtokens[i].istype(RawTokenType::EQUAL)) {
+         splittoken(ProcessedComparisonToken(LpComparisonType::EQ, position));
          i++;
          continue;
       }
 
       // FILEEND
-      if (rawtokens[i]->istype(RawTokenType::FLEND)) {
+      if (rawtokens[i].istype(RawTokenType::FLEND)) {
+         // not part of the input, so not counted
+         nrawtokens--;
          i++;
          continue;
       }
@@ -778,156 +1919,133 @@ void Reader::processtokens() {
       lpassert(false);
       break;
    }
-}
-
-// reads the entire file and separates 
-void Reader::tokenize() {
-   this->linebufferrefill = true;
-   bool done = false;
-   while(true) {
-      this->readnexttoken(done);
-      if (this->rawtokens.size() >= 1 && this->rawtokens.back()->type == RawTokenType::FLEND) {
-         break;
-      }
-   }
+   // the keyword a chunk reader stops at is left to the main reader
+   nrawtokens += stopped ? start : i;
+   this->rawtokens.erase(this->rawtokens.begin(), this->rawtokens.begin() + i);
 }
 
 void Reader::readnexttoken(bool& done) {
    done = false;
-   if (this->linebufferrefill) {
-      char* eof = fgets(this->linebuffer, LP_MAX_LINE_LENGTH+1, this->file);
-      this->linebufferpos = this->linebuffer;
-      this->linebufferrefill = false;
-
-      unsigned int linelength;
-      for (linelength=0; linelength<LP_MAX_LINE_LENGTH; linelength++) {
-         if (this->linebuffer[linelength] == '\r') {
-            this->linebuffer[linelength] = '\n';
-         }
-         if (this->linebuffer[linelength] == '\n') {
-            break;
-         }
-      }
-      lpassert (this->linebuffer[linelength] == '\n');
-
-      // fgets returns nullptr if end of file reached (EOF following a \n)
-      if (eof == nullptr) {
-         this->rawtokens.push_back(std::unique_ptr<RawToken>(new RawToken(RawTokenType::FLEND)));
-         done = true;
-         return;
-      }
+   if (this->inputpos == this->inputend && this->stream != nullptr) {
+      // the input may have moved while it grew
+      size_t position = this->inputpos - this->data;
+      size_t available = this->stream->wait(position);
+      this->data = this->stream->begin();
+      this->inputpos = this->data + position;
+      this->inputend = this->data + available;
+   }
+   if (this->inputpos == this->inputend) {
+      this->rawtokens.push_back(RawToken(RawTokenType::FLEND, this->inputpos - this->data));
+      done = true;
+      return;
    }
 
    // check single character tokens
-   char nextchar = *this->linebufferpos;
+   char nextchar = *this->inputpos;
 
    switch (nextchar) {
       // check for comment
-      case '\\':
-         this->linebufferrefill = true;
+      case '\\': {
+         const char* lineend = (const char*)memchr(this->inputpos, '\n', this->inputend - this->inputpos);
+         this->inputpos = lineend == nullptr ? this->inputend : lineend;
          return;
+      }
       
       // check for bracket opening
       case '[':
-         this->rawtokens.push_back(std::unique_ptr<RawToken>(new RawToken(RawTokenType::BRKOP)));
-         this->linebufferpos++;
+         this->rawtokens.push_back(RawToken(RawTokenType::BRKOP, this->inputpos - this->data));
+         this->inputpos++;
          return;
 
       // check for bracket closing
       case ']':
-         this->rawtokens.push_back(std::unique_ptr<RawToken>(new RawToken(RawTokenType::BRKCL)));
-         this->linebufferpos++;
+         this->rawtokens.push_back(RawToken(RawTokenType::BRKCL, this->inputpos - this->data));
+         this->inputpos++;
          return;
 
       // check for less sign
       case '<':
-         this->rawtokens.push_back(std::unique_ptr<RawToken>(new RawToken(RawTokenType::LESS)));
-         this->linebufferpos++;
+         this->rawtokens.push_back(RawToken(RawTokenType::LESS, this->inputpos - this->data));
+         this->inputpos++;
          return;
 
       // check for greater sign
       case '>':
-         this->rawtokens.push_back(std::unique_ptr<RawToken>(new RawToken(RawTokenType::GREATER)));
-         this->linebufferpos++;
+         this->rawtokens.push_back(RawToken(RawTokenType::GREATER, this->inputpos - this->data));
+         this->inputpos++;
          return;
 
       // check for equal sign
       case '=':
-         this->rawtokens.push_back(std::unique_ptr<RawToken>(new RawToken(RawTokenType::EQUAL)));
-         this->linebufferpos++;
+         this->rawtokens.push_back(RawToken(RawTokenType::EQUAL, this->inputpos - this->data));
+         this->inputpos++;
          return;
       
       // check for colon
       case ':':
-         this->rawtokens.push_back(std::unique_ptr<RawToken>(new RawToken(RawTokenType::COLON)));
-         this->linebufferpos++;
+         this->rawtokens.push_back(RawToken(RawTokenType::COLON, this->inputpos - this->data));
+         this->inputpos++;
          return;
 
       // check for plus
       case '+':
-         this->rawtokens.push_back(std::unique_ptr<RawToken>(new RawToken(RawTokenType::PLUS)));
-         this->linebufferpos++;
+         this->rawtokens.push_back(RawToken(RawTokenType::PLUS, this->inputpos - this->data));
+         this->inputpos++;
          return;
 
       // check for hat
       case '^':
-         this->rawtokens.push_back(std::unique_ptr<RawToken>(new RawToken(RawTokenType::HAT)));
-         this->linebufferpos++;
+         this->rawtokens.push_back(RawToken(RawTokenType::HAT, this->inputpos - this->data));
+         this->inputpos++;
          return;
 
       // check for hat
       case '/':
-         this->rawtokens.push_back(std::unique_ptr<RawToken>(new RawToken(RawTokenType::SLASH)));
-         this->linebufferpos++;
+         this->rawtokens.push_back(RawToken(RawTokenType::SLASH, this->inputpos - this->data));
+         this->inputpos++;
          return;
 
       // check for asterisk
       case '*':
-         this->rawtokens.push_back(std::unique_ptr<RawToken>(new RawToken(RawTokenType::ASTERISK)));
-         this->linebufferpos++;
+         this->rawtokens.push_back(RawToken(RawTokenType::ASTERISK, this->inputpos - this->data));
+         this->inputpos++;
          return;
       
       // check for minus
       case '-':
-         this->rawtokens.push_back(std::unique_ptr<RawToken>(new RawToken(RawTokenType::MINUS)));
-         this->linebufferpos++;
+         this->rawtokens.push_back(RawToken(RawTokenType::MINUS, this->inputpos - this->data));
+         this->inputpos++;
          return;
 
-      // check for whitespace
+      // check for whitespace and line ends
       case ' ':
       case '\t':
-         this->linebufferpos++;
-         return;
-
-      // check for line end
+      case '\r':
       case '\n':
-         this->linebufferrefill = true;
+         this->inputpos++;
          return;
 
-      // check for file end (EOF at end of some line)
+      // check for file end (embedded null character)
       case '\0': 
-         this->rawtokens.push_back(std::unique_ptr<RawToken>(new RawToken(RawTokenType::FLEND)));
+         this->rawtokens.push_back(RawToken(RawTokenType::FLEND, this->inputpos - this->data));
          done = true;
          return;
    }
    
    // check for double value
    double constant;
-   int ncharconsumed;
-   int nread = sscanf(this->linebufferpos, "%lf%n", &constant, &ncharconsumed);
-   if (nread == 1) {
-      this->rawtokens.push_back(std::unique_ptr<RawToken>(new RawConstantToken(constant)));
-      this->linebufferpos += ncharconsumed;
+   const char* numberend = lexnumber(this->inputpos, this->inputend, constant);
+   if (numberend != this->inputpos) {
+      this->rawtokens.push_back(RawConstantToken(constant, this->inputpos - this->data));
+      this->inputpos = numberend;
       return;
    }
 
    // assume it's an (section/variable/constraint) idenifier
-   char stringbuffer[LP_MAX_NAME_LENGTH+1];
-   nread = sscanf(this->linebufferpos, "%[^][\t\n\\:+<>^= /-]%n",
-                 stringbuffer, &ncharconsumed);
-   if (nread == 1) {
-      this->rawtokens.push_back(std::unique_ptr<RawToken>(new RawStringToken(stringbuffer)));
-      this->linebufferpos += ncharconsumed;
+   const char* identifierend = lexidentifier(this->inputpos, this->inputend);
+   if (identifierend != this->inputpos) {
+      this->rawtokens.push_back(RawStringToken(this->inputpos - this->data, identifierend - this->inputpos));
+      this->inputpos = identifierend;
       return;
    }
    
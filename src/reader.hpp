@@ -1,10 +1,149 @@
 #ifndef __READERLP_READER_HPP__
 #define __READERLP_READER_HPP__
 
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <istream>
 #include <string>
+#include <vector>
 
+#include "compactmodel.hpp"
+#include "handler.hpp"
 #include "model.hpp"
 
+// a phase of the parse on the timeline, times in seconds since its start
+struct ParseEvent {
+   std::string name;
+   unsigned int thread;
+   double start;
+   double duration;
+};
+
+// where a parse spends its time. the times are wall clock seconds spent in
+// each phase itself, without the phases it calls. when the constraint section
+// is parsed in parallel, times and counts are summed over the threads.
+struct ParseStats {
+   double totaltime = 0.0;
+   double cachetime = 0.0;           // looking up and storing the cache entry
+   double iotime = 0.0;              // mapping or reading the file
+   double tokenizetime = 0.0;        // splitting the input into raw tokens
+   double processtokenstime = 0.0;   // turning raw tokens into processed tokens
+   double splittokenstime = 0.0;     // collecting the tokens of each section
+   double objsectime = 0.0;          // turning the statements of each section into the model
+   double consectime = 0.0;
+   double boundssectime = 0.0;
+   double gensectime = 0.0;
+   double binsectime = 0.0;
+   double semisectime = 0.0;
+   double sossectime = 0.0;
+   double mergetime = 0.0;           // appending the rows of parallel chunks
+   double finishtime = 0.0;          // completing the compact model
+   double createmodeltime = 0.0;     // building the Model from the compact model
+
+   uint64_t bytes = 0;
+   uint64_t rawtokens = 0;
+   uint64_t processedtokens = 0;
+   uint64_t tokenmemory = 0;         // peak size of the token buffers in bytes
+   uint64_t variables = 0;
+   uint64_t constraints = 0;
+   uint64_t nonzeros = 0;
+   uint64_t arenamemory = 0;         // reserved by the arena of an ArenaModel
+
+   // sections, parallel chunks and the other coarse phases
+   std::vector<ParseEvent> events;
+};
+
+struct ReaderOptions {
+   // directory to cache parsed files in, no caching if empty
+   std::string cachedirectory;
+
+   // the cache directory is kept below this many bytes
+   uint64_t cachebudget = (uint64_t)1 << 30;
+
+   // threads parsing the constraint section, 0 for one per core. the result
+   // does not depend on the number of threads. the section is split before
+   // named rows and after lines that end a row with "variable <comparison>
+   // constant", so files without such lines are read by one thread.
+   unsigned int nthreads = 1;
+
+   // filled with statistics of the parse if set. collecting them does not
+   // change the result, and without them the reader does not measure anything.
+   ParseStats* stats = nullptr;
+
+   // size in bytes of the blocks readarenainstance allocates the model from.
+   // ModelArena::usage tells how much memory it took.
+   size_t arenablocksize = 1 << 20;
+};
+
 Model readinstance(std::string filename);
+Model readinstance(std::string filename, const ReaderOptions& options);
+
+// reads the instance into a model in an arena of blocks, which saves an
+// allocation and a free per object, name and term list
+ArenaModel readarenainstance(std::string filename, const ReaderOptions& options);
+
+// reads the instance into its index based form, without building the Model
+CompactModel readcompactinstance(std::string filename);
+CompactModel readcompactinstance(std::string filename, const ReaderOptions& options);
+
+// read an instance held in memory. the buffer is parsed in place and may be
+// compressed, it has to stay valid until the call returns.
+Model readinstance(const char* data, size_t length);
+Model readinstance(const char* data, size_t length, const ReaderOptions& options);
+CompactModel readcompactinstance(const char* data, size_t length);
+CompactModel readcompactinstance(const char* data, size_t length, const ReaderOptions& options);
+
+// read an instance from the rest of a stream, parsed while it is read. the
+// cache is only used for files.
+Model readinstance(std::istream& input);
+Model readinstance(std::istream& input, const ReaderOptions& options);
+CompactModel readcompactinstance(std::istream& input);
+CompactModel readcompactinstance(std::istream& input, const ReaderOptions& options);
+
+// parser for input that arrives in pieces, from a socket or pipe say. the
+// pieces are parsed on a second thread while they arrive, a line at a time,
+// so they may end anywhere, even within a number or name. compressed input
+// is parsed once it is complete.
+class IncrementalReader {
+private:
+   struct State;
+   State* state;
+
+   IncrementalReader(const IncrementalReader&);
+   IncrementalReader& operator=(const IncrementalReader&);
+
+public:
+   IncrementalReader();
+   IncrementalReader(const ReaderOptions& options);
+   ~IncrementalReader();
+
+   // throws if the input is found to be invalid
+   void feed(const char* data, size_t length);
+
+   // ends the input and returns the instance
+   CompactModel finish();
+};
+
+// called for each file of a batch as soon as it is read, on the thread that
+// read it. index is the position of the file in the batch. if reading the
+// file failed, error is set and the instance is empty.
+template <typename Instance>
+using BatchCallback = std::function<void(size_t index, Instance& instance, std::exception_ptr error)>;
+
+// read a batch of files on options.nthreads threads, largest files first,
+// each file by a single thread. statistics are not collected.
+std::vector<Model> readinstances(const std::vector<std::string>& filenames, const ReaderOptions& options);
+void readinstances(const std::vector<std::string>& filenames, const ReaderOptions& options, const BatchCallback<Model>& callback);
+std::vector<CompactModel> readcompactinstances(const std::vector<std::string>& filenames, const ReaderOptions& options);
+void readcompactinstances(const std::vector<std::string>& filenames, const ReaderOptions& options, const BatchCallback<CompactModel>& callback);
+
+// read an instance into handler, without building a model. memory use does
+// not grow with the number of constraints.
+void readinstance(std::string filename, ParseHandler& handler);
+void readinstance(const char* data, size_t length, ParseHandler& handler);
+
+// writes the events of stats as Chrome trace (chrome://tracing, Perfetto)
+void writetrace(std::string filename, const ParseStats& stats);
 
 #endif
@@ -0,0 +1,275 @@
+#include "snapshot.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+#include "def.hpp"
+
+class SnapshotWriter {
+private:
+   FILE* file;
+   uint64_t written = 0;
+
+   void writebytes(const void* data, size_t length) {
+      lpassert(fwrite(data, 1, length, file) == length);
+      written += length;
+   }
+
+   template <typename T>
+   void writearray(const T* data, size_t length) {
+      static const char padding[8] = {};
+      uint64_t count = length;
+      writebytes(&count, sizeof(count));
+      writebytes(data, length * sizeof(T));
+      writebytes(padding, (8 - written % 8) % 8);
+   }
+
+   template <typename T>
+   void writearray(const std::vector<T>& array) {
+      writearray(array.data(), array.size());
+   }
+
+   void writearray(const std::vector<size_t>& array) {
+      std::vector<uint64_t> converted(array.begin(), array.end());
+      writearray(converted.data(), converted.size());
+   }
+
+   void writearray(const std::string& str) {
+      writearray(str.data(), str.size());
+   }
+
+   void writehessian(const Hessian& hessian) {
+      writearray(hessian.start);
+      writearray(hessian.index);
+      writearray(hessian.value);
+   }
+
+public:
+   SnapshotWriter(std::string filename) : file(fopen(filename.c_str(), "wb")) {
+      lpassert(file != nullptr);
+   }
+
+   ~SnapshotWriter() {
+      fclose(file);
+   }
+
+   void write(const CompactModel& model);
+};
+
+void SnapshotWriter::write(const CompactModel& model) {
+   SnapshotHeader header;
+   memset(&header, 0, sizeof(header));
+   memcpy(header.magic, LP_SNAPSHOT_MAGIC, sizeof(header.magic));
+   header.endian = LP_SNAPSHOT_ENDIAN;
+   header.version = LP_SNAPSHOT_VERSION;
+   header.sense = (uint32_t)model.sense;
+   header.ncols = model.ncols();
+   header.nrows = model.nrows();
+   header.nquadrows = (uint32_t)model.quadrows.size();
+   header.objoffset = model.objoffset;
+   writebytes(&header, sizeof(header));
+
+   std::vector<uint8_t> coltype(model.coltype.size());
+   for (size_t i=0; i<coltype.size(); i++) {
+      coltype[i] = (uint8_t)model.coltype[i];
+   }
+
+   writearray(model.collower);
+   writearray(model.colupper);
+   writearray(coltype);
+   writearray(model.colnames);
+   writearray(model.colnamestart);
+
+   writearray(model.objname);
+   writearray(model.objindex);
+   writearray(model.objvalue);
+   writehessian(model.objhessian);
+
+   writearray(model.rowlower);
+   writearray(model.rowupper);
+   writearray(model.rowoffset);
+   writearray(model.rowstart);
+   writearray(model.colindex);
+   writearray(model.value);
+   writearray(model.rownames);
+   writearray(model.rownamestart);
+
+   writearray(model.quadrows);
+   for (size_t i=0; i<model.rowhessians.size(); i++) {
+      writehessian(model.rowhessians[i]);
+   }
+
+   // the size lets the reader detect truncated files
+   header.filesize = written;
+   lpassert(fseek(file, 0, SEEK_SET) == 0);
+   lpassert(fwrite(&header, sizeof(header), 1, file) == 1);
+}
+
+void writesnapshot(std::string filename, const CompactModel& model) {
+   SnapshotWriter writer(filename);
+   writer.write(model);
+}
+
+void writesnapshot(std::string filename, const Model& model) {
+   writesnapshot(filename, createcompactmodel(model));
+}
+
+template <typename T>
+void nextarray(const char*& pos, const char* end, SnapshotArray<T>& array) {
+   lpassert(end - pos >= 8);
+   uint64_t length;
+   memcpy(&length, pos, sizeof(length));
+   pos += sizeof(length);
+
+   lpassert(length <= (uint64_t)(end - pos) / sizeof(T));
+   uint64_t padded = (length * sizeof(T) + 7) / 8 * 8;
+   lpassert(padded <= (uint64_t)(end - pos));
+
+   array.data = (const T*)pos;
+   array.length = (size_t)length;
+   pos += padded;
+}
+
+// start has n + 1 entries that do not decrease and end at length, so every
+// range [start[i], start[i+1]) lies within an array of that length
+void checkstarts(const SnapshotArray<uint64_t>& start, size_t n, size_t length) {
+   lpassert(start.size() == n + 1);
+   for (size_t i=0; i<n; i++) {
+      lpassert(start[i] <= start[i+1]);
+   }
+   lpassert(start[n] == length);
+}
+
+void checkindices(const SnapshotArray<uint32_t>& index, uint32_t n) {
+   for (size_t k=0; k<index.size(); k++) {
+      lpassert(index[k] < n);
+   }
+}
+
+void nexthessian(const char*& pos, const char* end, SnapshotHessian& hessian) {
+   nextarray(pos, end, hessian.start);
+   nextarray(pos, end, hessian.index);
+   nextarray(pos, end, hessian.value);
+   lpassert(hessian.start.size() >= 1);
+   lpassert(hessian.index.size() == hessian.value.size());
+   checkstarts(hessian.start, hessian.start.size() - 1, hessian.value.size());
+}
+
+// the hessian refers to the columns [0, ncols) only
+void checkhessian(const SnapshotHessian& hessian, uint32_t ncols) {
+   lpassert(hessian.start.size() - 1 <= ncols);
+   checkindices(hessian.index, ncols);
+}
+
+Snapshot::Snapshot(std::string filename) : file(filename) {
+   const char* pos = file.begin();
+   const char* end = file.end();
+
+   // arrays are read in place, which needs them to be aligned
+   lpassert((uintptr_t)pos % 8 == 0);
+   lpassert(file.length() >= sizeof(SnapshotHeader));
+   header = (const SnapshotHeader*)pos;
+   lpassert(memcmp(header->magic, LP_SNAPSHOT_MAGIC, sizeof(header->magic)) == 0);
+   lpassert(header->endian == LP_SNAPSHOT_ENDIAN);
+   lpassert(header->version == LP_SNAPSHOT_VERSION);
+   lpassert(header->filesize == file.length());
+   pos += sizeof(SnapshotHeader);
+
+   nextarray(pos, end, collower);
+   nextarray(pos, end, colupper);
+   nextarray(pos, end, coltype);
+   nextarray(pos, end, colnames);
+   nextarray(pos, end, colnamestart);
+
+   nextarray(pos, end, objname);
+   nextarray(pos, end, objindex);
+   nextarray(pos, end, objvalue);
+   nexthessian(pos, end, objhessian);
+
+   nextarray(pos, end, rowlower);
+   nextarray(pos, end, rowupper);
+   nextarray(pos, end, rowoffset);
+   nextarray(pos, end, rowstart);
+   nextarray(pos, end, colindex);
+   nextarray(pos, end, value);
+   nextarray(pos, end, rownames);
+   nextarray(pos, end, rownamestart);
+
+   nextarray(pos, end, quadrows);
+   lpassert(quadrows.size() == header->nquadrows);
+   rowhessians.resize(header->nquadrows);
+   for (uint32_t i=0; i<header->nquadrows; i++) {
+      nexthessian(pos, end, rowhessians[i]);
+   }
+   lpassert(pos == end);
+
+   // a damaged snapshot is rejected here, rather than read out of bounds later
+   uint32_t ncols = header->ncols;
+   uint32_t nrows = header->nrows;
+   lpassert(header->sense == (uint32_t)ObjectiveSense::MIN || header->sense == (uint32_t)ObjectiveSense::MAX);
+   lpassert(collower.size() == ncols && colupper.size() == ncols && coltype.size() == ncols);
+   for (size_t i=0; i<ncols; i++) {
+      lpassert(coltype[i] <= (uint8_t)VariableType::SEMICONTINUOUS);
+   }
+   checkstarts(colnamestart, ncols, colnames.size());
+
+   lpassert(objindex.size() == objvalue.size());
+   checkindices(objindex, ncols);
+   checkhessian(objhessian, ncols);
+
+   lpassert(rowlower.size() == nrows && rowupper.size() == nrows && rowoffset.size() == nrows);
+   checkstarts(rowstart, nrows, value.size());
+   lpassert(colindex.size() == value.size());
+   checkindices(colindex, ncols);
+   checkstarts(rownamestart, nrows, rownames.size());
+
+   for (size_t i=0; i<quadrows.size(); i++) {
+      lpassert(quadrows[i] < nrows && (i == 0 || quadrows[i-1] < quadrows[i]));
+      checkhessian(rowhessians[i], ncols);
+   }
+}
+
+CompactModel Snapshot::tocompactmodel() const {
+   CompactModel model;
+   model.sense = sense();
+
+   model.collower = collower.copy();
+   model.colupper = colupper.copy();
+   model.coltype.resize(coltype.size());
+   for (size_t i=0; i<coltype.size(); i++) {
+      model.coltype[i] = (VariableType)coltype[i];
+   }
+   model.colnames = colnames.copy();
+   model.colnamestart.assign(colnamestart.begin(), colnamestart.end());
+
+   model.objname.assign(objname.begin(), objname.end());
+   model.objoffset = objoffset();
+   model.objindex = objindex.copy();
+   model.objvalue = objvalue.copy();
+   model.objhessian.start.assign(objhessian.start.begin(), objhessian.start.end());
+   model.objhessian.index = objhessian.index.copy();
+   model.objhessian.value = objhessian.value.copy();
+
+   model.rowlower = rowlower.copy();
+   model.rowupper = rowupper.copy();
+   model.rowoffset = rowoffset.copy();
+   model.rowstart.assign(rowstart.begin(), rowstart.end());
+   model.colindex = colindex.copy();
+   model.value = value.copy();
+   model.rownames = rownames.copy();
+   model.rownamestart.assign(rownamestart.begin(), rownamestart.end());
+
+   model.quadrows = quadrows.copy();
+   model.rowhessians.resize(rowhessians.size());
+   for (size_t i=0; i<rowhessians.size(); i++) {
+      model.rowhessians[i].start.assign(rowhessians[i].start.begin(), rowhessians[i].start.end());
+      model.rowhessians[i].index = rowhessians[i].index.copy();
+      model.rowhessians[i].value = rowhessians[i].value.copy();
+   }
+   return model;
+}
+
+CompactModel readsnapshot(std::string filename) {
+   Snapshot snapshot(filename);
+   return snapshot.tocompactmodel();
+}
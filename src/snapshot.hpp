@@ -0,0 +1,103 @@
+#ifndef __READERLP_SNAPSHOT_HPP__
+#define __READERLP_SNAPSHOT_HPP__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "compactmodel.hpp"
+#include "mappedfile.hpp"
+
+// binary snapshot of a CompactModel. the file starts with a SnapshotHeader,
+// followed by arrays in a fixed order, each one given by its number of
+// elements (uint64_t) and the elements, padded to a multiple of 8 bytes.
+// snapshots are only read on machines of the same byte order they were
+// written on.
+const char LP_SNAPSHOT_MAGIC[8] = {'L', 'P', 'S', 'N', 'A', 'P', '\0', '\0'};
+const uint32_t LP_SNAPSHOT_ENDIAN = 0x01020304;
+const uint32_t LP_SNAPSHOT_VERSION = 1;
+
+struct SnapshotHeader {
+   char magic[8];
+   uint32_t endian;
+   uint32_t version;
+   uint64_t filesize;
+   uint32_t sense;
+   uint32_t ncols;
+   uint32_t nrows;
+   uint32_t nquadrows;
+   double objoffset;
+};
+
+// contiguous array inside a snapshot
+template <typename T>
+struct SnapshotArray {
+   const T* data = nullptr;
+   size_t length = 0;
+
+   const T* begin() const { return data; }
+   const T* end() const { return data + length; }
+   size_t size() const { return length; }
+   const T& operator[](size_t i) const { return data[i]; }
+   std::vector<T> copy() const { return std::vector<T>(begin(), end()); }
+};
+
+struct SnapshotHessian {
+   SnapshotArray<uint64_t> start;
+   SnapshotArray<uint32_t> index;
+   SnapshotArray<double> value;
+};
+
+// snapshot file mapped into memory. all arrays point into the mapping, so
+// opening a snapshot only validates it and copies nothing. every start array
+// and index is checked, so a damaged file is rejected with invalid_argument.
+class Snapshot {
+private:
+   MappedFile file;
+   const SnapshotHeader* header;
+
+   Snapshot(const Snapshot&);
+   Snapshot& operator=(const Snapshot&);
+
+public:
+   SnapshotArray<double> collower;
+   SnapshotArray<double> colupper;
+   SnapshotArray<uint8_t> coltype;
+   SnapshotArray<char> colnames;
+   SnapshotArray<uint64_t> colnamestart;
+
+   SnapshotArray<char> objname;
+   SnapshotArray<uint32_t> objindex;
+   SnapshotArray<double> objvalue;
+   SnapshotHessian objhessian;
+
+   SnapshotArray<double> rowlower;
+   SnapshotArray<double> rowupper;
+   SnapshotArray<double> rowoffset;
+   SnapshotArray<uint64_t> rowstart;
+   SnapshotArray<uint32_t> colindex;
+   SnapshotArray<double> value;
+   SnapshotArray<char> rownames;
+   SnapshotArray<uint64_t> rownamestart;
+
+   SnapshotArray<uint32_t> quadrows;
+   std::vector<SnapshotHessian> rowhessians;
+
+   Snapshot(std::string filename);
+
+   ObjectiveSense sense() const { return (ObjectiveSense)header->sense; }
+   double objoffset() const { return header->objoffset; }
+   uint32_t ncols() const { return header->ncols; }
+   uint32_t nrows() const { return header->nrows; }
+   size_t nnz() const { return value.size(); }
+
+   // copies the snapshot into a CompactModel
+   CompactModel tocompactmodel() const;
+};
+
+void writesnapshot(std::string filename, const CompactModel& model);
+void writesnapshot(std::string filename, const Model& model);
+
+CompactModel readsnapshot(std::string filename);
+
+#endif
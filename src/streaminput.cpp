@@ -0,0 +1,179 @@
+#include "streaminput.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <new>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+#include "def.hpp"
+
+bool StreamInput::reserve(size_t size) {
+#ifndef _WIN32
+   // pages of the reserved address space are only committed once they are written
+   void* addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+   if (addr != MAP_FAILED) {
+      data = (char*)addr;
+      capacity = size;
+      reserved = true;
+      return true;
+   }
+#endif
+   (void)size;
+   return false;
+}
+
+// doubles the capacity until it is at least needed. called with the mutex
+// held, by the producer or, once a reader is attached, by the reader.
+void StreamInput::grow() {
+#ifndef _WIN32
+   size_t size = capacity;
+   while (size < needed) {
+      if (size > SIZE_MAX / 2) {
+         throw std::bad_alloc();
+      }
+      size *= 2;
+   }
+#ifdef __linux__
+   void* addr = mremap(data, capacity, size, MREMAP_MAYMOVE);
+   if (addr == MAP_FAILED) {
+      throw std::bad_alloc();
+   }
+#else
+   void* addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+   if (addr == MAP_FAILED) {
+      throw std::bad_alloc();
+   }
+   memcpy(addr, data, used);
+   munmap(data, capacity);
+#endif
+   data = (char*)addr;
+   capacity = size;
+#endif
+}
+
+bool StreamInput::makeroom(size_t used, size_t size) {
+   std::unique_lock<std::mutex> lock(mutex);
+   this->used = used;
+   needed = size;
+   if (!attached) {
+      grow();
+      return true;
+   }
+
+   // the reader may be using the input, it grows it once it waits
+   changed.notify_all();
+   changed.wait(lock, [&]() { return capacity >= size || failed || cancelled; });
+   return capacity >= size && !cancelled;
+}
+
+// grows the input for the producer if it waits for that. called by the
+// reader with the mutex held, when it does not use the input.
+void StreamInput::growforproducer() {
+   if (needed > capacity && !failed) {
+      try {
+         grow();
+      } catch (const std::bad_alloc&) {
+         failed = true;
+         finished = true;
+      }
+      changed.notify_all();
+   }
+}
+
+StreamInput::~StreamInput() {
+#ifndef _WIN32
+   if (reserved) {
+      munmap(data, capacity);
+   }
+#endif
+}
+
+bool StreamInput::publish(size_t end, bool done) {
+   std::lock_guard<std::mutex> lock(mutex);
+   if (cancelled) {
+      return false;
+   }
+   if (end > available || done) {
+      available = end;
+      finished = done;
+      changed.notify_all();
+   }
+   return true;
+}
+
+void StreamInput::fail() {
+   std::lock_guard<std::mutex> lock(mutex);
+   failed = true;
+   finished = true;
+   changed.notify_all();
+}
+
+size_t StreamInput::wait(size_t end) {
+   std::unique_lock<std::mutex> lock(mutex);
+   attached = true;
+   growforproducer();
+   while (!finished && !cancelled && available <= end) {
+      changed.wait(lock);
+      growforproducer();
+   }
+   lpassert(!failed && !cancelled);
+   return available;
+}
+
+size_t StreamInput::waitall() {
+   std::unique_lock<std::mutex> lock(mutex);
+   attached = true;
+   growforproducer();
+   while (!finished && !cancelled) {
+      changed.wait(lock);
+      growforproducer();
+   }
+   lpassert(!failed && !cancelled);
+   return available;
+}
+
+void StreamInput::cancel() {
+   std::lock_guard<std::mutex> lock(mutex);
+   cancelled = true;
+   changed.notify_all();
+}
+
+size_t lastlineend(const char* data, size_t begin, size_t end) {
+   while (end > begin && data[end - 1] != '\n') {
+      end--;
+   }
+   return end;
+}
+
+PushInput::PushInput(size_t reservation) {
+   reserve(reservation);
+}
+
+bool PushInput::push(const char* piece, size_t length) {
+   if (!reserved) {
+      buffer.insert(buffer.end(), piece, piece + length);
+      received += length;
+      return true;
+   }
+
+   // only the producer writes beyond what is available
+   if (length > capacity - received && !makeroom(received, received + length)) {
+      return false;
+   }
+   memcpy(data + received, piece, length);
+   size_t before = received;
+   received += length;
+   size_t end = lastlineend(data, before, received);
+   return end == before || publish(end, false);
+}
+
+void PushInput::finish() {
+   if (!reserved) {
+      data = buffer.data();
+      capacity = buffer.size();
+   }
+   publish(received, true);
+}
@@ -0,0 +1,95 @@
+#ifndef __READERLP_STREAMINPUT_HPP__
+#define __READERLP_STREAMINPUT_HPP__
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+// address space first reserved for streamed input. it is doubled whenever
+// the input outgrows it.
+const size_t LP_STREAM_RESERVATION = (size_t)1 << 26;
+
+// input that becomes available while it is being read. it is kept in one
+// contiguous block, so that tokens can refer to it by position, and it is
+// made available a line at a time, so tokens are never cut off at its end.
+// the block moves when it grows, but only within wait, so the reader has to
+// take begin again after each wait.
+class StreamInput {
+protected:
+   char* data = nullptr;
+   size_t capacity = 0;
+   bool reserved = false;       // data is reserved address space rather than owned
+   std::vector<char> buffer;
+
+   std::mutex mutex;
+   std::condition_variable changed;
+   size_t available = 0;
+   bool finished = false;
+   bool failed = false;
+   bool cancelled = false;
+   bool attached = false;       // a reader waits for the input
+   size_t needed = 0;           // capacity the producer waits for
+   size_t used = 0;             // bytes written by the producer, kept when growing
+
+   // reserves size bytes of address space for the input, false if that is
+   // not possible
+   bool reserve(size_t size);
+
+   // makes the capacity at least size, keeping the first used bytes. once a
+   // reader is attached, it does that in its next wait. returns false if the
+   // reader is gone or the address space is exhausted.
+   bool makeroom(size_t used, size_t size);
+   void grow();
+   void growforproducer();
+
+   // makes [data, data + end) available, done if that is all of the input.
+   // returns false if the reader is gone.
+   bool publish(size_t end, bool done);
+   void fail();
+
+   StreamInput() {}
+   StreamInput(const StreamInput&);
+   StreamInput& operator=(const StreamInput&);
+
+public:
+   virtual ~StreamInput();
+
+   const char* begin() const { return data; }
+
+   // waits until there is input beyond offset end or all of it is there,
+   // and returns the length of the available input
+   size_t wait(size_t end);
+
+   // waits until all input is there and returns its length
+   size_t waitall();
+
+   // no more input is needed, the producer may stop
+   void cancel();
+};
+
+// the end of the last complete line in [begin, end), begin if there is none
+size_t lastlineend(const char* data, size_t begin, size_t end);
+
+// input handed over in pieces by the caller, which may end anywhere
+class PushInput : public StreamInput {
+private:
+   size_t received = 0;
+
+public:
+   PushInput(size_t reservation = LP_STREAM_RESERVATION);
+
+   // whether the input is available while it arrives, otherwise it only
+   // becomes available with finish
+   bool isstreaming() const { return reserved; }
+
+   // returns false if the reader is gone
+   bool push(const char* piece, size_t length);
+   void finish();
+
+   // the input received so far, for the producer
+   const char* contents() const { return reserved ? data : buffer.data(); }
+   size_t length() const { return received; }
+};
+
+#endif
@@ -0,0 +1,101 @@
+#include "symboltable.hpp"
+
+#include <cstring>
+
+const uint32_t SymbolTable::NONE;
+
+const size_t LP_SYMBOLTABLE_MIN_SLOTS = 64;
+
+// FNV-1a
+uint32_t SymbolTable::hash(const char* name, size_t length) {
+   uint32_t h = 2166136261u;
+   for (size_t i = 0; i < length; i++) {
+      h ^= (unsigned char)name[i];
+      h *= 16777619u;
+   }
+   return h;
+}
+
+bool SymbolTable::equal(uint32_t id, const char* name, size_t length) const {
+   return this->length(id) == length && memcmp(this->name(id), name, length) == 0;
+}
+
+void SymbolTable::rehash(size_t nslots) {
+   slots.assign(nslots, 0);
+   mask = (uint32_t)(nslots - 1);
+   for (uint32_t id = 0; id < hashes.size(); id++) {
+      uint32_t slot = hashes[id] & mask;
+      while (slots[slot] != 0) {
+         slot = (slot + 1) & mask;
+      }
+      slots[slot] = id + 1;
+   }
+}
+
+uint32_t SymbolTable::intern(const char* name, size_t length, bool& inserted) {
+   // keep the load factor at or below 1/2
+   if (2 * (hashes.size() + 1) > slots.size()) {
+      rehash(slots.empty() ? LP_SYMBOLTABLE_MIN_SLOTS : 2 * slots.size());
+   }
+
+   uint32_t h = hash(name, length);
+   uint32_t slot = h & mask;
+   while (slots[slot] != 0) {
+      uint32_t id = slots[slot] - 1;
+      if (hashes[id] == h && equal(id, name, length)) {
+         inserted = false;
+         return id;
+      }
+      slot = (slot + 1) & mask;
+   }
+
+   uint32_t id = (uint32_t)hashes.size();
+   slots[slot] = id + 1;
+   hashes.push_back(h);
+   names.insert(names.end(), name, name + length);
+   namestart.push_back(names.size());
+   inserted = true;
+   return id;
+}
+
+uint32_t SymbolTable::find(const char* name, size_t length) const {
+   if (slots.empty()) {
+      return NONE;
+   }
+
+   uint32_t h = hash(name, length);
+   uint32_t slot = h & mask;
+   while (slots[slot] != 0) {
+      uint32_t id = slots[slot] - 1;
+      if (hashes[id] == h && equal(id, name, length)) {
+         return id;
+      }
+      slot = (slot + 1) & mask;
+   }
+   return NONE;
+}
+
+void SymbolTable::reserve(size_t n, size_t namelength) {
+   names.reserve(namelength);
+   namestart.reserve(n + 1);
+   hashes.reserve(n);
+
+   size_t nslots = LP_SYMBOLTABLE_MIN_SLOTS;
+   while (nslots < 2 * n) {
+      nslots *= 2;
+   }
+   if (nslots > slots.size()) {
+      rehash(nslots);
+   }
+}
+
+void SymbolTable::movenames(std::vector<char>& names, std::vector<size_t>& namestart) {
+   names.swap(this->names);
+   namestart.swap(this->namestart);
+
+   this->names.clear();
+   this->namestart.assign(1, 0);
+   hashes.clear();
+   slots.clear();
+   mask = 0;
+}
@@ -0,0 +1,51 @@
+#ifndef __READERLP_SYMBOLTABLE_HPP__
+#define __READERLP_SYMBOLTABLE_HPP__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// interns names and numbers them densely in order of first appearance.
+// lookups take the name as pointer and length, so they never construct a
+// temporary string.
+class SymbolTable {
+private:
+   std::vector<char> names;            // all interned names, back to back
+   std::vector<size_t> namestart;      // id -> offset of its name, plus end marker
+   std::vector<uint32_t> hashes;       // id -> hash of its name
+   std::vector<uint32_t> slots;        // open addressing, linear probing. id+1, 0 is empty
+   uint32_t mask = 0;
+
+   static uint32_t hash(const char* name, size_t length);
+   bool equal(uint32_t id, const char* name, size_t length) const;
+   void rehash(size_t nslots);
+
+public:
+   static const uint32_t NONE = UINT32_MAX;
+
+   // most bytes reserve takes per name, besides the name itself: its offset,
+   // its hash and up to four slots
+   static const size_t RESERVED_BYTES = sizeof(size_t) + 5 * sizeof(uint32_t);
+
+   SymbolTable() : namestart(1, 0) {}
+
+   // returns the id of name, adding it if it is not known yet
+   uint32_t intern(const char* name, size_t length, bool& inserted);
+
+   // returns the id of name, or NONE if it is not known
+   uint32_t find(const char* name, size_t length) const;
+
+   // make room for n names of total length namelength
+   void reserve(size_t n, size_t namelength);
+
+   // hands the names over to the caller and leaves the table empty
+   void movenames(std::vector<char>& names, std::vector<size_t>& namestart);
+
+   size_t size() const { return hashes.size(); }
+   size_t memory() const { return names.capacity() + namestart.capacity() * sizeof(size_t) + (hashes.capacity() + slots.size()) * sizeof(uint32_t); }
+   const char* name(uint32_t id) const { return names.data() + namestart[id]; }
+   size_t length(uint32_t id) const { return namestart[id+1] - namestart[id]; }
+   std::string str(uint32_t id) const { return std::string(name(id), length(id)); }
+};
+
+#endif
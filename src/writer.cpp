@@ -1,174 +1,308 @@
 #include "writer.hpp"
 
-#include <cstdarg>
+#include <cmath>
 #include <cstdio>
+#include <vector>
 
+#include "compression.hpp"
 #include "def.hpp"
+#include "numberformat.hpp"
+#include "parallel.hpp"
 
 const std::string LP_COMMENT_FILESTART = "File written by FilereaderLP (https://github.com/feldmeier/FilereaderLP)";
 
-class Writer {
+// output is collected up to this size before it is written to the file
+const size_t LP_WRITER_BUFFER_SIZE = 1 << 20;
+
+// rows and variables are formatted in chunks of about this many terms
+const size_t LP_WRITER_CHUNK_TERMS = 1 << 16;
+
+// formatted part of the output. every line of a section ends within the
+// chunk that starts it, so the line breaks do not depend on how the
+// output is split into chunks.
+class WriterChunk {
 private:
-   FILE* file;
-   char linebuffer[LP_MAX_LINE_LENGTH];
+   OutputFile* file;    // written to once the buffer is full, if set
+   std::vector<char> buffer;
+   std::string token;   // the token being assembled, it is never split across lines
    unsigned int linelength = 0;
+   bool hexfloat = false;
 
-   void writetofile(const char* format, ...);
+   void append(const std::string& str) { token.append(str); }
+   void append(const char* str) { token.append(str); }
+   void appendnumber(double value);
+   void writetoken();
    void writelineend();
 
-   void writeexpression(std::shared_ptr<Expression> expr);
+   void writeexpression(const Expression& expr);
 
 public:
-   Writer(std::string filename) : file(fopen(filename.c_str(), "w")) {
-      lpassert(file != nullptr);
-   };
+   WriterChunk(OutputFile* file = nullptr, bool hexfloat = false) : file(file), hexfloat(hexfloat) {}
 
-   ~Writer() {
-      fclose(file);
-   }
+   void writeheader(const Model& model);
+   void writekeyword(const std::string& keyword);
+   void writeconstraints(const Model& model, size_t begin, size_t end);
+   void writebounds(const Model& model, size_t begin, size_t end);
+   void writetypes(const Model& model, VariableType type, size_t begin, size_t end);
+
+   void flush(OutputFile& file);
+};
+
+class Writer {
+private:
+   OutputFile file;
+   WriterOptions options;
+
+   template <typename Weight, typename Format>
+   void writeparallel(size_t n, Weight weight, Format format);
+
+public:
+   Writer(std::string filename, const WriterOptions& options) : file(filename, options.compression), options(options) {};
 
    void write(const Model& model);
 };
 
 void writeinstance(std::string filename, const Model& model) {
-   Writer writer(filename);
+   writeinstance(filename, model, WriterOptions());
+}
+
+void writeinstance(std::string filename, const Model& model, const WriterOptions& options) {
+   Writer writer(filename, options);
    writer.write(model);
 }
 
-void Writer::writetofile(const char* format, ...) {
-   va_list argptr;
-   va_start(argptr, format);
-   unsigned int tokenlength = (unsigned int)vsprintf(this->linebuffer, format, argptr);
-   if (linelength + tokenlength >= LP_MAX_LINE_LENGTH) {
-      fprintf(this->file, "\n");
-      fprintf(this->file, "%s", this->linebuffer);
-      this->linelength = tokenlength;
+// always signed, like %+g, but with as many digits as needed to read back the same value
+void WriterChunk::appendnumber(double value) {
+   char number[LP_MAX_NUMBER_LENGTH + 1];
+   char* end = number;
+   if (!std::signbit(value)) {
+      *end++ = '+';
+   }
+   end = hexfloat ? formathexdouble(value, end) : formatdouble(value, end);
+   token.append(number, end);
+}
+
+void WriterChunk::writetoken() {
+   if (linelength + token.size() >= LP_MAX_LINE_LENGTH) {
+      buffer.push_back('\n');
+      linelength = (unsigned int)token.size();
    } else {
-      fprintf(this->file, "%s", this->linebuffer);
-      this->linelength += tokenlength;
+      linelength += (unsigned int)token.size();
+   }
+   buffer.insert(buffer.end(), token.begin(), token.end());
+   token.clear();
+   if (file != nullptr && buffer.size() >= LP_WRITER_BUFFER_SIZE) {
+      flush(*file);
    }
 }
 
-void Writer::writelineend() {
-  fprintf(this->file, "\n");
-  this->linelength = 0;
+void WriterChunk::writelineend() {
+   buffer.push_back('\n');
+   linelength = 0;
 }
 
-void Writer::writeexpression(std::shared_ptr<Expression> expr) {
-   // if (expr->name != "") {
-   //    writetofile("%s: ", expr->name.c_str());
+void WriterChunk::flush(OutputFile& file) {
+   file.write(buffer.data(), buffer.size());
+   buffer.clear();
+}
+
+void WriterChunk::writeexpression(const Expression& expr) {
+   // if (expr.name != "") {
+   //    append(expr.name);
+   //    append(": ");
    // }
 
-   for (unsigned int i = 0; i < expr->linterms.size(); i++) {
-      std::shared_ptr<LinTerm> lt = expr->linterms[i];
-      writetofile("%+g %s ", lt->coef, lt->var->name.c_str());
+   for (unsigned int i = 0; i < expr.linterms.size(); i++) {
+      const LinTerm& lt = *expr.linterms[i];
+      appendnumber(lt.coef);
+      append(" ");
+      append(lt.var->name);
+      append(" ");
+      writetoken();
    }
 
-   if (expr->quadterms.size() > 0) {
-      if (expr->linterms.size() > 0) {
-         writetofile("+ ");
+   if (expr.quadterms.size() > 0) {
+      if (expr.linterms.size() > 0) {
+         append("+ ");
+         writetoken();
       }
-      writetofile("[ ");
-      
-      for (unsigned int i=0; i<expr->quadterms.size(); i++) {
-         std::shared_ptr<QuadTerm> qt = expr->quadterms[i];
-         writetofile("%+g ", qt->coef);
-         if (qt->var1 == qt->var2) {
-            writetofile("%s^2 ", qt->var1->name.c_str());
+      append("[ ");
+      writetoken();
+
+      for (unsigned int i=0; i<expr.quadterms.size(); i++) {
+         const QuadTerm& qt = *expr.quadterms[i];
+         appendnumber(qt.coef);
+         append(" ");
+         writetoken();
+         if (qt.var1 == qt.var2) {
+            append(qt.var1->name);
+            append("^2 ");
          } else {
-            writetofile("%s * %s ", qt->var1->name.c_str(), qt->var2->name.c_str());
+            append(qt.var1->name);
+            append(" * ");
+            append(qt.var2->name);
+            append(" ");
          }
+         writetoken();
       }
 
-      writetofile("]/2");
+      append("]/2");
+      writetoken();
    }
 }
 
-void Writer::write(const Model& model) {
+void WriterChunk::writekeyword(const std::string& keyword) {
+   append(keyword);
+   writetoken();
+   writelineend();
+}
+
+void WriterChunk::writeheader(const Model& model) {
    // write comment
-   writetofile("\\ %s", LP_COMMENT_FILESTART.c_str());
+   append("\\ ");
+   append(LP_COMMENT_FILESTART);
+   writetoken();
    writelineend();
 
    // write objective section
-   writetofile("%s", model.sense == ObjectiveSense::MIN ? LP_KEYWORD_MIN[0].c_str() : LP_KEYWORD_MAX[0].c_str());
-   writelineend();
-   writeexpression(model.objective);
+   writekeyword(model.sense == ObjectiveSense::MIN ? LP_KEYWORD_MIN[0] : LP_KEYWORD_MAX[0]);
+   writeexpression(*model.objective);
    writelineend();
+}
 
-   // write constraints
-   writetofile("%s", LP_KEYWORD_ST[0].c_str());
-   writelineend();
-   for (unsigned int i=0; i<model.constraints.size(); i++) {
-      std::shared_ptr<Constraint> con = model.constraints[i];
-      
-      if (con->lowerbound == con->upperbound) {
-         writeexpression(con->expr);
-         writetofile("= %+g", con->lowerbound);
-      } else if (con->lowerbound == -std::numeric_limits<double>::infinity()) {
-         writeexpression(con->expr);
-         writetofile("<= %+g", con->upperbound);
-      } else if (con->upperbound == std::numeric_limits<double>::infinity()) {
-         writeexpression(con->expr);
-         writetofile(">= %+g", con->lowerbound);
+void WriterChunk::writeconstraints(const Model& model, size_t begin, size_t end) {
+   for (size_t i=begin; i<end; i++) {
+      const Constraint& con = *model.constraints[i];
+
+      if (con.lowerbound == con.upperbound) {
+         writeexpression(*con.expr);
+         append("= ");
+         appendnumber(con.lowerbound);
+         writetoken();
+      } else if (con.lowerbound == -std::numeric_limits<double>::infinity()) {
+         writeexpression(*con.expr);
+         append("<= ");
+         appendnumber(con.upperbound);
+         writetoken();
+      } else if (con.upperbound == std::numeric_limits<double>::infinity()) {
+         writeexpression(*con.expr);
+         append(">= ");
+         appendnumber(con.lowerbound);
+         writetoken();
       } else {
-         writeexpression(con->expr);
-         writetofile("<= %+g", con->upperbound);
-         writelineend();
-         writeexpression(con->expr);
-         writetofile(">= %+g", con->lowerbound);
+         appendnumber(con.lowerbound);
+         append(" <= ");
+         writetoken();
+         writeexpression(*con.expr);
+         append("<= ");
+         appendnumber(con.upperbound);
+         writetoken();
       }
       writelineend();
    }
+}
 
-   // write bounds
-   writetofile("%s", LP_KEYWORD_BOUNDS[0].c_str());
-   writelineend();
-   for (unsigned int i=0; i<model.variables.size(); i++) {
-      std::shared_ptr<Variable> var = model.variables[i];
-      if (var->lowerbound == -std::numeric_limits<double>::infinity() && var->upperbound == std::numeric_limits<double>::infinity()) {
-         writetofile("%s %s", var->name.c_str(), LP_KEYWORD_FREE[0].c_str());
+void WriterChunk::writebounds(const Model& model, size_t begin, size_t end) {
+   for (size_t i=begin; i<end; i++) {
+      const Variable& var = *model.variables[i];
+      if (var.lowerbound == -std::numeric_limits<double>::infinity() && var.upperbound == std::numeric_limits<double>::infinity()) {
+         append(var.name);
+         append(" ");
+         append(LP_KEYWORD_FREE[0]);
+         writetoken();
       } else {
-         writetofile("%+g <= %s <= %+g", var->lowerbound, var->name.c_str(), var->upperbound);
+         appendnumber(var.lowerbound);
+         append(" <= ");
+         append(var.name);
+         append(" <= ");
+         appendnumber(var.upperbound);
+         writetoken();
       }
       writelineend();
    }
+}
 
-   // write bin section
-   writetofile("%s", LP_KEYWORD_BIN[0].c_str());
-   writelineend();
-   for (unsigned int i=0; i<model.variables.size(); i++) {
-      std::shared_ptr<Variable> var = model.variables[i];
-      if (var->type == VariableType::BINARY) {
-         writetofile(" %s", var->name.c_str());
+void WriterChunk::writetypes(const Model& model, VariableType type, size_t begin, size_t end) {
+   for (size_t i=begin; i<end; i++) {
+      const Variable& var = *model.variables[i];
+      if (var.type == type) {
+         append(" ");
+         append(var.name);
+         writetoken();
          writelineend();
       }
    }
+}
 
-   // write gen section
-   writetofile("%s", LP_KEYWORD_GEN[0].c_str());
-   writelineend();
-   for (unsigned int i=0; i<model.variables.size(); i++) {
-      std::shared_ptr<Variable> var = model.variables[i];
-      if (var->type == VariableType::GENERAL) {
-         writetofile(" %s", var->name.c_str());
-         writelineend();
+// formats the items [0, n) in rounds of one chunk per thread and writes the
+// chunks in order. a chunk holds items of about LP_WRITER_CHUNK_TERMS weight.
+template <typename Weight, typename Format>
+void Writer::writeparallel(size_t n, Weight weight, Format format) {
+   unsigned int nthreads = getthreadcount(options.nthreads);
+   std::vector<WriterChunk> chunks(nthreads, WriterChunk(nullptr, options.hexfloat));
+   std::vector<size_t> start;
+
+   size_t next = 0;
+   while (next < n) {
+      start.assign(1, next);
+      while (start.size() <= nthreads && next < n) {
+         size_t terms = 0;
+         while (next < n && terms < LP_WRITER_CHUNK_TERMS) {
+            terms += weight(next);
+            next++;
+         }
+         start.push_back(next);
       }
-   }
 
-   // write semi section
-   writetofile("%s", LP_KEYWORD_SEMI[0].c_str());
-   writelineend();
-   for (unsigned int i=0; i<model.variables.size(); i++) {
-      std::shared_ptr<Variable> var = model.variables[i];
-      if (var->type == VariableType::SEMICONTINUOUS) {
-         writetofile(" %s", var->name.c_str());
-         writelineend();
+      runparallel((unsigned int)start.size() - 1, [&](unsigned int c) {
+         format(chunks[c], start[c], start[c+1]);
+      });
+      for (size_t c=0; c+1<start.size(); c++) {
+         chunks[c].flush(file);
       }
    }
+}
+
+void Writer::write(const Model& model) {
+   WriterChunk out(&file, options.hexfloat);
+   out.writeheader(model);
+
+   // write constraints
+   out.writekeyword(LP_KEYWORD_ST[0]);
+   out.flush(file);
+   writeparallel(model.constraints.size(), [&](size_t i) {
+      const Expression& expr = *model.constraints[i]->expr;
+      return 1 + expr.linterms.size() + expr.quadterms.size();
+   }, [&](WriterChunk& chunk, size_t begin, size_t end) {
+      chunk.writeconstraints(model, begin, end);
+   });
+
+   // write bounds
+   out.writekeyword(LP_KEYWORD_BOUNDS[0]);
+   out.flush(file);
+   writeparallel(model.variables.size(), [](size_t) {
+      return (size_t)1;
+   }, [&](WriterChunk& chunk, size_t begin, size_t end) {
+      chunk.writebounds(model, begin, end);
+   });
+
+   // write bin, gen and semi sections
+   const std::string* keywords[] = {&LP_KEYWORD_BIN[0], &LP_KEYWORD_GEN[0], &LP_KEYWORD_SEMI[0]};
+   const VariableType types[] = {VariableType::BINARY, VariableType::GENERAL, VariableType::SEMICONTINUOUS};
+   for (unsigned int s=0; s<3; s++) {
+      out.writekeyword(*keywords[s]);
+      out.flush(file);
+      writeparallel(model.variables.size(), [](size_t) {
+         return (size_t)1;
+      }, [&](WriterChunk& chunk, size_t begin, size_t end) {
+         chunk.writetypes(model, types[s], begin, end);
+      });
+   }
 
    // TODO: write SOS section
 
    // write end
-   writetofile("%s", LP_KEYWORD_END[0].c_str());
-   writelineend();
+   out.writekeyword(LP_KEYWORD_END[0]);
+   out.flush(file);
+   file.close();
 }
@@ -3,8 +3,23 @@
 
 #include <string>
 
+#include "compression.hpp"
 #include "model.hpp"
 
+struct WriterOptions {
+   // threads formatting the constraints, bounds and types, 0 for one per core.
+   // the output does not depend on the number of threads.
+   unsigned int nthreads = 1;
+
+   // compression of the file, done on a second thread while the output is formatted
+   Compression compression = Compression::NONE;
+
+   // write numbers as C99 hexadecimal floats (0x1.8p+1) rather than decimal.
+   // they read back exactly as well, but are cheaper to write and to read.
+   bool hexfloat = false;
+};
+
 void writeinstance(std::string filename, const Model& model);
+void writeinstance(std::string filename, const Model& model, const WriterOptions& options);
 
 #endif